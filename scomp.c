@@ -0,0 +1,436 @@
+
+#include <string.h>
+#include "sgc.h"
+#include "scomp.h"
+#include "slang.h"
+#include "seval.h"
+#include "seval_impl.h"
+#include "slib.h"
+
+typedef struct {
+    long *insns;
+    size_t nb_insns;
+    size_t nb_alloc;
+    long nb_consts;
+    // The locals of the lambda live on the stack. Outer envs are then
+    // one level closer, unless there's an env for runtime definitions.
+    // @see vm_execute()
+    bool_t stack_env;
+    bool_t defs_env;
+    // Constants are collected in a reversed list on the frame, and
+    // temporaries are pushed below it. @see comp_push()
+    obj_t **consts_slot;
+    obj_t **sp;
+} compiler_t;
+
+static void compile_node(compiler_t *c, obj_t *node, bool_t tail);
+
+// Buffer management
+
+static void
+comp_init(compiler_t *c, obj_t **frame)
+{
+    c->nb_alloc = 64;
+    c->nb_insns = 0;
+    c->insns = malloc(c->nb_alloc * sizeof(long));
+    if (!c->insns)
+        fatal_error("out of memory", frame);
+    c->nb_consts = 0;
+    c->stack_env = 0;
+    c->defs_env = 0;
+
+    frame = frame_extend(frame, 1, FR_SAVE_PREV | FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = nil_wrap();
+    c->consts_slot = frame_ref(frame, 0);
+    c->sp = frame;
+}
+
+static void
+comp_push(compiler_t *c, obj_t *o)
+{
+    --c->sp;
+    *c->sp = o;
+}
+
+static void
+comp_pop(compiler_t *c, long n)
+{
+    c->sp += n;
+}
+
+static long
+emit(compiler_t *c, long word)
+{
+    if (c->nb_insns == c->nb_alloc) {
+        c->nb_alloc *= 2;
+        c->insns = realloc(c->insns, c->nb_alloc * sizeof(long));
+        if (!c->insns)
+            fatal_error("out of memory", c->sp);
+    }
+    c->insns[c->nb_insns] = word;
+    return c->nb_insns++;
+}
+
+static void
+patch(compiler_t *c, long pos, long word)
+{
+    c->insns[pos] = word;
+}
+
+// Forward jumps to a target which is not known yet are chained through
+// their operands, starting from -1. Patch them all to here.
+static void
+patch_chain(compiler_t *c, long chain)
+{
+    long next;
+    for (; chain >= 0; chain = next) {
+        next = c->insns[chain];
+        patch(c, chain, c->nb_insns);
+    }
+}
+
+// A new entry of the constant pool, which is not shared.
+static long
+new_const(compiler_t *c, obj_t *value)
+{
+    comp_push(c, value);
+    *c->consts_slot = pair_wrap(c->sp, value, *c->consts_slot);
+    comp_pop(c, 1);
+    return c->nb_consts++;
+}
+
+static long
+add_const(compiler_t *c, obj_t *value)
+{
+    obj_t *iter;
+    long index = c->nb_consts - 1;
+
+    for (iter = *c->consts_slot; pairp(iter); iter = pair_cdr(iter)) {
+        if (pair_car(iter) == value)
+            return index;
+        --index;
+    }
+    return new_const(c, value);
+}
+
+// Move the result into the code object.
+static void
+comp_finish(compiler_t *c, obj_t *code)
+{
+    obj_t *consts, *iter;
+    long i;
+
+    comp_push(c, code);
+    consts = vector_wrap(c->sp, c->nb_consts, nil_wrap());
+    for (i = c->nb_consts - 1, iter = *c->consts_slot; i >= 0;
+            --i, iter = pair_cdr(iter)) {
+        vector_set(consts, i, pair_car(iter));
+    }
+    comp_pop(c, 1);
+
+    code_set_insns(code, c->insns, c->nb_insns, consts);
+    c->insns = NULL;
+}
+
+// Code generation
+
+// The code object of a lambda, compiled on its first application.
+static obj_t *
+lambda_code(compiler_t *c, obj_t *lambda)
+{
+    obj_t *code = slang_lambda_code(lambda);
+    if (nullp(code)) {
+        code = code_wrap(c->sp, lambda);
+        slang_lambda_set_code(lambda, code);
+    }
+    return code;
+}
+
+// Access to a local variable, which may be in a stack env.
+static void
+compile_local(compiler_t *c, enum opcode op, enum opcode stack_op,
+              obj_t *node)
+{
+    long depth = node_ival(node);
+
+    if (c->stack_env && depth == 0) {
+        emit(c, stack_op);
+    }
+    else {
+        emit(c, op);
+        emit(c, c->stack_env && !c->defs_env ? depth - 1 : depth);
+    }
+    emit(c, node_slot(node));
+}
+
+// The primitive called by the node, if it can be inlined, or -1.
+static long
+inline_prim(obj_t *node)
+{
+    obj_t *proc = node_ref(node, 0);
+    long prim;
+
+    if (node_kind(proc) != ND_GREF) {
+        return -1;
+    }
+    for (prim = 0; prim < NB_LIB_PRIMS; ++prim) {
+        if (lib_prim_symbol(prim) == node_ref(proc, 0) &&
+                lib_prim_argc(prim) == node_length(node) - 1) {
+            return prim;
+        }
+    }
+    return -1;
+}
+
+static void
+compile_node(compiler_t *c, obj_t *node, bool_t tail)
+{
+    long i, len, pos, end_pos, chain, prim;
+    obj_t *datums, *iter;
+
+    switch (node_kind(node)) {
+
+    case ND_CONST:
+        emit(c, OP_CONST);
+        emit(c, add_const(c, node_ref(node, 0)));
+        break;
+
+    case ND_LREF:
+        compile_local(c, OP_LREF, OP_SREF, node);
+        break;
+
+    case ND_GREF:
+        emit(c, OP_GREF);
+        emit(c, add_const(c, node_ref(node, 0)));
+        // The node holds the cache and the env it was found from until
+        // the first lookup, as no other constant can be eq? to it.
+        emit(c, new_const(c, node));
+        new_const(c, node);
+        emit(c, -1);
+        break;
+
+    case ND_LSET:
+        compile_node(c, node_ref(node, 1), 0);
+        compile_local(c, OP_LSET, OP_SSET, node);
+        break;
+
+    case ND_GSET:
+        compile_node(c, node_ref(node, 1), 0);
+        emit(c, OP_GSET);
+        emit(c, add_const(c, node_ref(node, 0)));
+        emit(c, new_const(c, node));
+        new_const(c, node);
+        emit(c, -1);
+        break;
+
+    case ND_DEFINE:
+        compile_node(c, node_ref(node, 1), 0);
+        emit(c, OP_DEFINE);
+        emit(c, add_const(c, node_ref(node, 0)));
+        break;
+
+    case ND_IF:
+        compile_node(c, node_ref(node, 0), 0);
+        emit(c, OP_JUMPF);
+        pos = emit(c, 0);
+        compile_node(c, node_ref(node, 1), tail);
+        if (!tail) {
+            emit(c, OP_JUMP);
+            end_pos = emit(c, 0);
+        }
+        patch(c, pos, c->nb_insns);
+        compile_node(c, node_ref(node, 2), tail);
+        if (!tail) {
+            patch(c, end_pos, c->nb_insns);
+        }
+        return;  // Both branches are done with the tail.
+
+    case ND_OR:
+        chain = -1;
+        for (i = 0, len = node_length(node); i < len - 1; ++i) {
+            compile_node(c, node_ref(node, i), 0);
+            emit(c, OP_JUMPT);
+            chain = emit(c, chain);
+        }
+        compile_node(c, node_ref(node, len - 1), tail);
+        patch_chain(c, chain);
+        break;  // The true values jump here.
+
+    case ND_CASE:
+        // The key stays on the stack while the datums are compared.
+        compile_node(c, node_ref(node, 0), 0);
+        chain = -1;
+        for (i = 1, len = node_length(node); i < len; i += 2) {
+            datums = node_ref(node, i);
+            pos = -1;
+            if (!booleanp(datums)) {
+                // Each test is 3 words, then the jump to the next clause.
+                for (iter = datums, end_pos = c->nb_insns + 2;
+                        pairp(iter); iter = pair_cdr(iter)) {
+                    end_pos += 3;
+                }
+                for (iter = datums; pairp(iter); iter = pair_cdr(iter)) {
+                    emit(c, OP_JUMPEQ);
+                    emit(c, add_const(c, pair_car(iter)));
+                    emit(c, end_pos);
+                }
+                emit(c, OP_JUMP);
+                pos = emit(c, 0);
+            }
+            emit(c, OP_POP);
+            compile_node(c, node_ref(node, i + 1), tail);
+            if (pos < 0) {
+                // The else clause is the last one.
+                patch_chain(c, chain);
+                return;
+            }
+            if (!tail) {
+                emit(c, OP_JUMP);
+                chain = emit(c, chain);
+            }
+            patch(c, pos, c->nb_insns);
+        }
+        emit(c, OP_POP);
+        emit(c, OP_CONST);
+        emit(c, add_const(c, unspec_wrap()));
+        patch_chain(c, chain);
+        break;
+
+    case ND_SEQ:
+        for (i = 0, len = node_length(node); i < len - 1; ++i) {
+            compile_node(c, node_ref(node, i), 0);
+            emit(c, OP_POP);
+        }
+        compile_node(c, node_ref(node, len - 1), tail);
+        return;
+
+    case ND_CALL:
+        prim = inline_prim(node);
+        if (prim >= 0) {
+            // The proc is pushed as for any call, then checked to be
+            // the primitive once the args are there.
+            len = node_length(node);
+            compile_node(c, node_ref(node, 0), 0);
+            if (node_kind(node_ref(node, len - 1)) == ND_CONST) {
+                // As in (- n 1), the constant goes with the call.
+                for (i = 1; i < len - 1; ++i) {
+                    compile_node(c, node_ref(node, i), 0);
+                }
+                emit(c, OP_PRIMK);
+                emit(c, add_const(c, node_ref(node_ref(node, len - 1), 0)));
+            }
+            else {
+                for (i = 1; i < len; ++i) {
+                    compile_node(c, node_ref(node, i), 0);
+                }
+                emit(c, OP_PRIM);
+            }
+            emit(c, prim);
+            emit(c, len - 1);
+            // Placeholder, @see ND_GREF
+            emit(c, new_const(c, node));
+            // The fallback call is a tail call when the node is one.
+            emit(c, tail);
+            break;
+        }
+        for (i = 0, len = node_length(node); i < len; ++i) {
+            compile_node(c, node_ref(node, i), 0);
+        }
+        emit(c, tail ? OP_TAILCALL : OP_CALL);
+        emit(c, len - 1);
+        if (tail) {
+            // Reached when the call can't be made in place, e.g. call/ec.
+            emit(c, OP_RETURN);
+        }
+        return;
+
+    case ND_LAMBDA:
+        emit(c, OP_CLOSURE);
+        emit(c, add_const(c, lambda_code(c, node)));
+        break;
+
+    case ND_MACRO:
+        emit(c, OP_MACRO);
+        emit(c, add_const(c, lambda_code(c, node_ref(node, 0))));
+        break;
+
+    case ND_CONS:
+    case ND_APPEND:
+        compile_node(c, node_ref(node, 0), 0);
+        compile_node(c, node_ref(node, 1), 0);
+        emit(c, node_kind(node) == ND_CONS ? OP_CONS : OP_APPEND);
+        break;
+
+    default:
+        NOT_REACHED();
+    }
+
+    if (tail) {
+        emit(c, OP_RETURN);
+    }
+}
+
+obj_t *
+scomp_toplevel(obj_t **frame)
+{
+    compiler_t c;
+    obj_t *code;
+
+    comp_init(&c, frame);
+    code = code_wrap(c.sp, nil_wrap());
+    comp_push(&c, code);
+    compile_node(&c, *frame_ref(frame, 0), 1);
+    comp_finish(&c, code);
+    return code;
+}
+
+// Compile the analysed body of the lambda into the code object.
+static void
+compile_lambda(obj_t **frame, obj_t *code, bool_t defs_env)
+{
+    compiler_t c;
+    obj_t *lambda = code_lambda(code);
+    obj_t *iter;
+    long nb_args = 0;
+
+    comp_init(&c, frame);
+    c.stack_env = defs_env || !slang_lambda_capturedp(lambda);
+    c.defs_env = defs_env;
+    compile_node(&c, slang_lambda_body(lambda), 1);
+    comp_finish(&c, code);
+    code_set_nb_slots(code, slang_lambda_nb_slots(lambda));
+    code_set_stack_env(code, c.stack_env);
+    code_set_defs_env(code, c.defs_env);
+
+    // The formals are checked by the analysis, the calls only check the
+    // number of args.
+    for (iter = slang_lambda_formals(lambda); pairp(iter);
+            iter = pair_cdr(iter)) {
+        ++nb_args;
+    }
+    code_set_arity(code, nb_args, symbolp(iter));
+}
+
+void
+scomp_lambda(obj_t **frame, obj_t *code)
+{
+    if (code_compiledp(code))
+        return;
+
+    frame = frame_extend(frame, 1, FR_SAVE_PREV | FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = code;
+    code_set_epoch(code, slang_macro_epoch);
+    slang_analyze_lambda(frame, code_lambda(code));
+    compile_lambda(frame, code, 0);
+}
+
+obj_t *
+scomp_lambda_defs_env(obj_t **frame, obj_t *code)
+{
+    // The lambda was analysed for the code, which is running.
+    frame = frame_extend(frame, 1, FR_SAVE_PREV | FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = code_wrap(frame, code_lambda(code));
+    code_set_epoch(*frame_ref(frame, 0), code_epoch(code));
+    compile_lambda(frame, *frame_ref(frame, 0), 1);
+    return *frame_ref(frame, 0);
+}
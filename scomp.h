@@ -0,0 +1,50 @@
+#ifndef SCOMP_H
+#define SCOMP_H
+
+#include "sobj.h"
+
+// The bytecode. Each instruction is a long opcode followed by its
+// operands, and k always stands for an index into the constant pool.
+// The binding of a global variable is cached in the constant pool at
+// cache, with the env it was found from at cache + 1. It's valid for
+// that env while version is the current environ_version.
+// OP_PRIM keeps the proc at cache once it's found to be the primitive,
+// which is then run inline.
+enum opcode {
+    OP_CONST,       // k -- push the constant
+    OP_LREF,        // depth, slot -- push the local variable
+    OP_GREF,        // k, cache, version -- push the global variable named k
+    OP_LSET,        // depth, slot -- pop into the local variable
+    OP_GSET,        // k, cache, version -- pop into the global named k
+    OP_SREF,        // slot -- push the local variable in a stack env
+    OP_SSET,        // slot -- pop into the local variable in a stack env
+    OP_DEFINE,      // k -- pop into a new binding of the current env
+    OP_POP,
+    OP_JUMP,        // target
+    OP_JUMPF,       // target -- pop, and jump if it's false
+    OP_JUMPT,       // target -- jump if it's true, or pop it
+    OP_JUMPEQ,      // k, target -- jump if it's eq? to the constant k
+    OP_CALL,        // argc
+    OP_TAILCALL,    // argc
+    OP_CLOSURE,     // k -- push a closure of the code object k
+    OP_MACRO,       // k -- push a macro of the code object k
+    OP_CONS,        // -- pop the cdr and the car, push their pair
+    OP_APPEND,      // -- pop the tail and a list, push the list ending with it
+    OP_PRIM,        // prim, argc, cache, tail -- call the proc under the args
+    OP_PRIMK,       // c, prim, argc, cache, tail -- push the constant c first
+    OP_RETURN,
+    NB_OPCODES
+};
+
+// Compile the analysed node on frame_ref(frame, 0) into a code object.
+obj_t *scomp_toplevel(obj_t **frame);
+
+// Analyse and compile the body of a lambda's code object, which is done
+// on its first application. The frame should carry the closure's env.
+void scomp_lambda(obj_t **frame, obj_t *code);
+
+// Compile the same lambda again, for a stack env with a heap env made
+// above it. The instructions are at the same offsets as in the code.
+obj_t *scomp_lambda_defs_env(obj_t **frame, obj_t *code);
+
+#endif /* SCOMP_H */
@@ -4,80 +4,9 @@
 (gc-set-verbosity #f)
 
 ;; mostly macros
-(define let
-  (lambda-syntax (bindings . body)
-    (define (bindings->keys bindings)
-      (map car bindings))
-    (define (bindings->vals bindings)
-      (map cadr bindings))
-    (define binding-keys (bindings->keys bindings))
-    (define binding-vals (bindings->vals bindings))
-    `((lambda ,binding-keys
-        ,@body)
-      ,@binding-vals)))
-
-(define (case->pred case-datum)
-  (let ((retval (car case-datum)))
-    (if (eq? retval 'else) #t
-      retval)))
-
-(define (case->body case-datum)
-  (cons 'begin (cdr case-datum)))
-
-(define (cases->if cases)
-  (define (cases->if1 cases result)
-    (if (null? cases) result
-      (let ((case-datum (car cases))
-            (rest (cdr cases)))
-        `(if ,(case->pred case-datum) ,(case->body case-datum)
-           ,(cases->if1 rest result)))))
-  (cases->if1 cases 'unspec))
-
-(define cond
-  (lambda-syntax cases
-    (if (null? cases) (error "empty cond")
-      (cases->if cases))))
-
-(define letrec
-  (lambda-syntax (bindings . body)
-    (let ((binding-defs (bindings->defines bindings)))
-      `((lambda ()
-          ,@binding-defs
-          ,@body)))))
-
-;; ... the same
-(define let*
-  (lambda-syntax (bindings . body)
-    (let ((binding-defs (bindings->defines bindings)))
-      `((lambda ()
-          ,@binding-defs
-          ,@body)))))
-
-(define (bindings->defines bindings)
-  (if (null? bindings) '()
-    (cons `(define ,@(car bindings))
-          (bindings->defines (cdr bindings)))))
-
-
 (define (not value)
   (if value #f #t))
 
-(define or
-  (lambda-syntax body
-    (if (null? body) #f
-      (let ((head (car body)))
-        `(if ,head ,head
-           (or ,@(cdr body)))))))
-
-
-(define and
-  (lambda-syntax body
-    (if (null? body) #t
-      (let ((head (car body))
-            (tail (cdr body)))
-        `(if ,head (and ,@tail)
-           #f)))))
-
 (define delay
   (lambda-syntax (expr)
     `(let ((forced #f)
@@ -131,8 +60,9 @@
 
 (define (vector . x) (list->vector x))
 
-;; only have escaping cont.
+;; call/cc is re-entrant within the evaluation that captured it.
 (define call/ec call-with-escaping-continuation)
+(define call/cc call-with-current-continuation)
 
 (define pretty-print
   (lambda-syntax (expr)
@@ -0,0 +1,38 @@
+; Objects of every size class, and large ones past the last class, keep
+; their contents while their neighbours are freed and the slots reused.
+; Expected: 20100 20100 (abc 10000 9999) done
+
+(define (show x) (display x) (newline))
+
+(define (vector-sum v i acc)
+  (if (< i (vector-length v))
+      (vector-sum v (+ i 1) (+ acc (vector-ref v i)))
+      acc))
+(define (make n) (make-vector n 1))
+
+; Vectors of 1 to 200 slots, every other one dropped.
+(define (build n keep drop)
+  (if (eq? n 0)
+      keep
+      (build (- n 1) (cons (make n) keep) (cons (make n) drop))))
+(define kept (build 200 '() '()))
+(define (total l acc)
+  (if (null? l) acc (total (cdr l) (+ acc (vector-sum (car l) 0 0)))))
+(show (total kept 0))
+
+(define (churn k)
+  (if (< 0 k) (begin (build 200 '() '()) (gc) (churn (- k 1)))))
+(churn 5)
+(show (total kept 0))
+
+(define name (symbol->string 'abc))
+(define big (make-vector 10000 1))
+(vector-set! big 9999 9999)
+(churn 2)
+(show (list (string->symbol name) (vector-length big) (vector-ref big 9999)))
+
+(define (hashes k)
+  (if (< 0 k)
+      (begin (hash-set! (make-hash) (gensym) (make k)) (hashes (- k 1)))
+      'done))
+(show (hashes 300))
@@ -0,0 +1,9 @@
+; A malformed form in a procedure body is reported when the body is
+; analysed, on the first call, and not when the procedure is defined.
+; Expected: defined, then FATAL -- if -- too few arguments
+
+(define (broken) (if))
+(display 'defined)
+(newline)
+(broken)
+(display 'not-reached)
@@ -0,0 +1,40 @@
+; Forms are analysed before they're run, and procedure bodies when they
+; are first called: a name may be used before it's defined, a body sees
+; its inner defines, and quoted data is the same object on each run.
+; Expected: 15 now-bound (1 ()) (1 (2 3)) 3 #t (a b) 7 #<unspecified> 42
+
+(define (show x) (display x) (newline))
+
+(define (h x)
+  (define y (+ x x))
+  (define (k z) (+ y z))
+  (set! x (k x))
+  x)
+(show (h 5))
+
+(define (uses-later) later)
+(define later 'now-bound)
+(show (uses-later))
+
+(define (rest a . more) (list a more))
+(show (rest 1))
+(show (rest 1 2 3))
+
+(show (eval '(+ 1 2) (scheme-report-environment 5)))
+
+(define (same) '(a b))
+(show (eq? (same) (same)))
+(show (same))
+
+(define twice (lambda-syntax (e) `(+ ,e ,e)))
+(define (use-twice) (twice (+ 1 2)))
+(show (+ 1 (use-twice)))
+
+(define (no-else) (if #f 1))
+(show (no-else))
+
+(define total 40)
+(define (bump!) (set! total (+ total 1)))
+(bump!)
+(bump!)
+(show total)
@@ -0,0 +1,28 @@
+; The entries of each arity: no formals, fixed formals, rest formals with
+; and without fixed ones, rest lists kept by a closure, calls through
+; apply, and macros with rest formals.
+; Expected: zero (1 2) (1 ()) (1 (2 3)) (1 (2 3)) (1 ()) () (1 2 3 4 5)
+; (1 2 3 4 5) (x (y z))
+
+(define (show x) (display x) (newline))
+
+(define (f0) 'zero)
+(define (f2 a b) (list a b))
+(define (r a . rest) (list a rest))
+(define (rc a . rest) (lambda () (list a rest)))
+(define (all . xs) xs)
+(show (f0))
+(show (f2 1 2))
+(show (r 1))
+(show (r 1 2 3))
+(show ((rc 1 2 3)))
+(show ((rc 1)))
+(show (all))
+(show (all 1 2 3 4 5))
+
+(define (loop n . acc)
+  (if (eq? n 0) acc (apply loop (cons (- n 1) (cons n acc)))))
+(show (loop 5))
+
+(define m (lambda-syntax (a . b) `(list ',a ',b)))
+(show (m x y z))
@@ -0,0 +1,4 @@
+; Expected: FATAL -- too many args in closure application -- expected 2, got 3
+(define (f a b) (list a b))
+(display (f 1 2)) (newline)
+(f 1 2 3)
@@ -0,0 +1,4 @@
+; Expected: FATAL -- not enough args in closure application -- expected at least 2, got 1
+(define (f a b . rest) (list a b rest))
+(display (f 1 2)) (newline)
+(f 1)
@@ -0,0 +1,8 @@
+; Any number of args past the fixed ones goes into the rest list.
+; Expected: (1 2 ()) (1 2 (3 4 5)) (1 2 (3 4 5)) (1 2 3)
+(define (f a b . rest) (list a b rest))
+(display (f 1 2)) (newline)
+(display (f 1 2 3 4 5)) (newline)
+(display (apply f '(1 2 3 4 5))) (newline)
+(define (g a . rest) (lambda () (cons a rest)))
+(display ((g 1 2 3))) (newline)
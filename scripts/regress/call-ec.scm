@@ -0,0 +1,29 @@
+; Escape continuations return their value from call/ec, whether they're
+; called in the receiver, in a procedure it calls, through eval or from
+; an inner call/ec, and call/ec returns normally when they aren't.
+; Expected: 1 5 3 3 4 outer 10000
+
+(define (show x) (display x) (newline))
+
+(show (call/ec (lambda (k) 1)))
+
+(define gk #f)
+(show (call/ec
+        (lambda (k)
+          (set! gk k)
+          (+ 1 (eval '(gk 5) (scheme-report-environment 5))))))
+
+(define (f k) (k 3))
+(show (call/ec (lambda (k) (+ 1 (f k)))))
+(show (call/ec f))
+
+(define (tl) (call/ec (lambda (k) (k 4) 0)))
+(show (tl))
+
+(show (call/ec
+        (lambda (outer)
+          (call/ec (lambda (inner) (outer 'outer)))
+          'inner)))
+
+(define (loop n) (if (eq? n 0) 0 (+ 1 (call/ec (lambda (k) (loop (- n 1)))))))
+(show (loop 10000))
@@ -0,0 +1,41 @@
+; call/cc continuations escape from deep recursion, can be resumed after
+; the procedure which made them returned, any number of times, and are
+; cheap enough to make on every turn of a long loop.
+; Expected: 3 (4 4 5 6) (0 1 2 3 4) done
+
+(define (show x) (display x) (newline))
+
+; Escape from the middle of a non-tail recursion.
+(define (find-first pred l)
+  (call/cc
+    (lambda (return)
+      (define (walk l)
+        (if (null? l) #f (begin (if (pred (car l)) (return (car l))) (walk (cdr l)))))
+      (walk l))))
+(show (find-first (lambda (x) (< 2 x)) '(1 2 3 4)))
+
+; Resume a continuation whose frame, deep in a recursion, has returned.
+(define resume #f)
+(define (count-up n)
+  (if (eq? n 0)
+      (call/cc (lambda (k) (set! resume k) 1))
+      (+ 1 (count-up (- n 1)))))
+(define (rev l acc) (if (null? l) acc (rev (cdr l) (cons (car l) acc))))
+(define (resumed)
+  (let ((results '()) (tries 0))
+    (let ((v (count-up 3)))
+      (set! results (cons v results))
+      (set! tries (+ tries 1))
+      (if (< tries 4) (resume tries) (rev results '())))))
+(show (resumed))
+
+; Resume the same continuation several times.
+(define (entries)
+  (let ((k #f) (seen '()))
+    (let ((n (call/cc (lambda (c) (set! k c) 0))))
+      (set! seen (cons n seen))
+      (if (< n 4) (k (+ n 1)) (rev seen '())))))
+(show (entries))
+
+(define (spin n) (if (eq? n 0) 'done (spin (call/cc (lambda (k) (k (- n 1)))))))
+(show (spin 1000000))
@@ -0,0 +1,62 @@
+; cond, case, and, or, when and unless: the value of each form, tests
+; evaluated once, => clauses, and the last expressions in tail position
+; so that loops through them run in constant stack space.
+; Expected: (neg zero small big) 2 no #<unspecified> 3 (c d)
+; (low mid sym other) #<unspecified> 1 3 (#f #t #f 1 #f #f) b
+; #<unspecified> c 1000000 #t #f done ok nested
+
+(define (show x) (display x) (newline))
+(define (assq k l)
+  (if (null? l) #f (if (eq? (car (car l)) k) (car l) (assq k (cdr l)))))
+(define (memq k l)
+  (if (null? l) #f (if (eq? (car l) k) l (memq k (cdr l)))))
+(define (classify n)
+  (cond ((< n 0) 'neg)
+        ((eq? n 0) 'zero)
+        ((< n 10) 'small)
+        (else 'big)))
+(show (list (classify -5) (classify 0) (classify 3) (classify 42)))
+(show (cond ((assq 'b '((a 1) (b 2))) => cadr) (else 'no)))
+(show (cond ((assq 'z '((a 1) (b 2))) => cadr) (else 'no)))
+(show (cond ((assq 'z '((a 1))) => cadr)))
+(show (cond (#f 1) ((+ 1 2))))
+(show (cond ((memq 'c '(a b c d)))))
+(define (kind x)
+  (case x
+    ((1 2 3) 'low)
+    ((4 5 6) 'mid)
+    ((a b) 'sym)
+    (else 'other)))
+(show (list (kind 1) (kind 5) (kind 'b) (kind 99)))
+(show (case 7 ((1) 'one)))
+(define (count-calls)
+  (let ((n 0))
+    (lambda () (set! n (+ n 1)) n)))
+(define tick (count-calls))
+(show (or #f (tick) (tick)))
+(show (and (tick) (tick)))
+(show (list (or) (and) (or #f) (and 1) (or #f #f) (and 1 #f 2)))
+(show (when (< 2 3) 'a 'b))
+(show (unless (< 2 3) 'a 'b))
+(show (unless #f 'c))
+(define (loop n acc)
+  (cond ((eq? n 0) acc)
+        ((< n 0) 'bad)
+        (else (loop (- n 1) (+ acc 1)))))
+(show (loop 1000000 0))
+(define (loop2 n)
+  (or (eq? n 0) (loop2 (- n 1))))
+(show (loop2 1000000))
+(define (loop3 n)
+  (and (< 0 n) (loop3 (- n 1))))
+(show (loop3 1000000))
+(define (loop4 n)
+  (case n ((0) 'done) (else (loop4 (- n 1)))))
+(show (loop4 1000000))
+(define (loop5 n)
+  (when (< 0 n) (loop5 (- n 1))))
+(loop5 1000000)
+(define (loop6 n)
+  (cond ((eq? n 0) 'ok) ((- n 1) => loop6)))
+(show (loop6 100000))
+(show (let ((x 2)) (case (+ x 1) ((3) (cond ((eq? x 2) 'nested))) (else 'no))))
@@ -0,0 +1,10 @@
+; A continuation belongs to the evaluation of the top-level form that
+; captured it, even when the next form runs on the same base frame.
+; Expected: prints 2, then FATAL -- continuation resumed out of its evaluation
+
+(define k #f)
+(display (+ 1 (call/cc (lambda (c) (set! k c) 1))))
+(newline)
+(define r (k 2))
+(display "unreachable")
+(newline)
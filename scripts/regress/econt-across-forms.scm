@@ -0,0 +1,9 @@
+; An escape continuation is dead once the form that made it has returned.
+; Expected: prints 1, then FATAL -- continuation already out of scope
+
+(define k #f)
+(display (call/ec (lambda (c) (set! k c) 1)))
+(newline)
+(define r (k 2))
+(display "unreachable")
+(newline)
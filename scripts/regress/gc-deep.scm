@@ -0,0 +1,22 @@
+; Marking doesn't recurse on the C stack: a million nested pairs, down
+; the car or down the cdr, survive major collections.
+; Expected: 1000000 1000000
+
+(define (nest n acc)
+  (if (eq? n 0) acc (nest (- n 1) (cons acc n))))
+(define (chain n acc)
+  (if (eq? n 0) acc (chain (- n 1) (cons n acc))))
+(define cars (nest 1000000 '()))
+(define cdrs (chain 1000000 '()))
+
+(define (churn k)
+  (if (< 0 k) (begin (nest 1000 '()) (churn (- k 1)))))
+(churn 2000)
+(gc)
+
+(define (depth x n) (if (pair? x) (depth (car x) (+ n 1)) n))
+(define (len x n) (if (pair? x) (len (cdr x) (+ n 1)) n))
+(display (depth cars 0))
+(newline)
+(display (len cdrs 0))
+(newline)
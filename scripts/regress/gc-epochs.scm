@@ -0,0 +1,26 @@
+; The meaning of the mark bit flips on each major collection: objects
+; which survived an odd or an even number of them, and objects made in
+; between, all stay alive while they're reachable.
+; Expected: 55 55 55 55 55 55 55 55 55 55 then 550
+
+(define (build n acc)
+  (if (eq? n 0) acc (build (- n 1) (cons n acc))))
+(define (sum l acc)
+  (if (null? l) acc (sum (cdr l) (+ acc (car l)))))
+
+; Each round keeps a list, and grows the heap past a few major
+; collections with garbage.
+(define kept '())
+(define (round k)
+  (if (< 0 k)
+      (begin
+        (set! kept (cons (build 10 '()) kept))
+        (build 60000 '())
+        (display (sum (car kept) 0))
+        (newline)
+        (round (- k 1)))))
+(round 10)
+
+(define (total l acc) (if (null? l) acc (total (cdr l) (+ acc (sum (car l) 0)))))
+(display (total kept 0))
+(newline)
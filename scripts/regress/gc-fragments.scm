@@ -0,0 +1,36 @@
+; Survivors scattered over many pages, with the pages around them freed
+; and given back, stay whole while the heap is re-sorted and refilled
+; in address order by later major collections.
+; Expected: 1000 500500 1000 500500
+
+(define (show x) (display x) (newline))
+
+(define (build n acc)
+  (if (eq? n 0) acc (build (- n 1) (cons n acc))))
+(define (sum l acc)
+  (if (null? l) acc (sum (cdr l) (+ acc (car l)))))
+
+; One pair and one 3-slot vector in every thousand objects survive.
+(define keep (make-vector 1000 0))
+(define (scatter i)
+  (if (< i 1000)
+      (begin
+        (build 500 '())
+        (vector-set! keep i (cons (+ i 1) (make-vector 3 (+ i 1))))
+        (build 500 '())
+        (scatter (+ i 1)))))
+(scatter 0)
+
+(define (check i n total)
+  (if (< i 1000)
+      (let ((p (vector-ref keep i)))
+        (check (+ i 1)
+               (if (eq? (car p) (vector-ref (cdr p) 2)) (+ n 1) n)
+               (+ total (car p))))
+      (list n total)))
+(define (report) (let ((r (check 0 0 0))) (show (car r)) (show (car (cdr r)))))
+(report)
+
+(define (refill k) (if (< 0 k) (begin (build 20000 '()) (refill (- k 1)))))
+(refill 20)
+(report)
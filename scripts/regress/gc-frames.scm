@@ -0,0 +1,30 @@
+; Collections walk the shadow stack by its tagged frame pointers: the
+; locals, arguments and partial results of thousands of pending frames,
+; fixnums among them, are all kept and left as they were.
+; Expected: 12502500 (1 2 3) 5000
+
+(define (show x) (display x) (newline))
+
+(define (build n acc)
+  (if (eq? n 0) acc (build (- n 1) (cons n acc))))
+
+; Each frame holds a fresh list while the ones below it collect.
+(define (deep n)
+  (if (eq? n 0)
+      (begin (gc) 0)
+      (let ((l (build 3 '())))
+        (gc)
+        (+ n (deep (- n 1)) (- (car (cdr (cdr l))) 3)))))
+(show (deep 5000))
+
+(define (hold a b c)
+  (build 1000 '())
+  (gc)
+  (list a b c))
+(show (hold 1 (car (cdr (hold 1 2 3))) 3))
+
+(define (count-after-gc n)
+  (if (eq? n 0)
+      (begin (build 100000 '()) 0)
+      (+ 1 (count-after-gc (- n 1)))))
+(show (count-after-gc 5000))
@@ -0,0 +1,57 @@
+; Old objects which are made to point to young ones, by vector-set!,
+; set-car!, set-cdr!, hash-set!, set! of a global or a captured local,
+; keep them alive through minor collections.
+; Expected: 13440 55 15 28 28 21 10
+
+(define (show x) (display x) (newline))
+
+(define (build n acc)
+  (if (eq? n 0) acc (build (- n 1) (cons n acc))))
+(define (sum l acc)
+  (if (null? l) acc (sum (cdr l) (+ acc (car l)))))
+
+(define v (make-vector 64 0))
+(define keep (cons 0 '()))
+(define g '())
+(define h (make-hash))
+(define (box)
+  (define held '())
+  (lambda (new) (if new (set! held new)) held))
+(define b (box))
+(gc)
+
+(define (fill i)
+  (if (< i 64)
+      (begin
+        (vector-set! v i (build 20 '()))
+        (fill (+ i 1)))))
+(define (churn k)
+  (if (< 0 k)
+      (begin
+        (build 200 '())
+        (fill 0)
+        (set-car! keep (build 10 '()))
+        (set-cdr! keep (list (build 5 '())))
+        (set! g (build 7 '()))
+        (hash-set! h 'l (build 6 '()))
+        (b (build 4 '()))
+        (churn (- k 1)))))
+(churn 300)
+
+(define (vsum i acc)
+  (if (< i 64) (vsum (+ i 1) (+ acc (sum (vector-ref v i) 0))) acc))
+(show (vsum 0 0))
+(show (sum (car keep) 0))
+(show (sum (car (cdr keep)) 0))
+(show (sum g 0))
+
+(define fs (make-vector 8 0))
+(define (mk i) (let ((l (build i '()))) (lambda () (sum l 0))))
+(define (fillf i)
+  (if (< i 8)
+      (begin (vector-set! fs i (mk i)) (build 100 '()) (fillf (+ i 1)))))
+(define (rep k) (if (< 0 k) (begin (fillf 0) (rep (- k 1)))))
+(rep 200)
+(show ((vector-ref fs 7)))
+(show (sum (hash-ref h 'l) 0))
+(show (sum (b #f) 0))
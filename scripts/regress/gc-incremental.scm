@@ -0,0 +1,32 @@
+; Major collections mark in slices of 50 microseconds, while the program
+; keeps storing new lists into a vector and a pair which were already
+; marked. Those lists must survive the end of the marking.
+; Expected: 25050000 1275
+
+(gc-set-pause-budget 50)
+
+(define (build n acc)
+  (if (eq? n 0) acc (build (- n 1) (cons (cons n n) acc))))
+(define (sum l acc)
+  (if (null? l) acc (sum (cdr l) (+ acc (car (car l))))))
+
+(define big (make-vector 200 0))
+(define tail (cons 0 '()))
+(define (fill i k)
+  (if (< i 200)
+      (begin (vector-set! big i (build k '())) (fill (+ i 1) k))))
+(define (churn k)
+  (if (< 0 k)
+      (begin
+        (fill 0 500)
+        (set-cdr! tail (build 50 '()))
+        (build 3000 '())
+        (churn (- k 1)))))
+(churn 40)
+
+(define (vsum i acc)
+  (if (< i 200) (vsum (+ i 1) (+ acc (sum (vector-ref big i) 0))) acc))
+(display (vsum 0 0))
+(newline)
+(display (sum (cdr tail) 0))
+(newline)
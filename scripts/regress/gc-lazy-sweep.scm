@@ -0,0 +1,26 @@
+; After a major collection the pages are swept as they're allocated
+; from: objects made into a partly swept heap, of the same size as the
+; dead ones around them, must not be swept themselves.
+; Expected: 5050 5050 5050 5050 5050 then 25250
+
+(define (build n acc)
+  (if (eq? n 0) acc (build (- n 1) (cons n acc))))
+(define (sum l acc)
+  (if (null? l) acc (sum (cdr l) (+ acc (car l)))))
+
+(define kept '())
+(define (round k)
+  (if (< 0 k)
+      (begin
+        ; Dead pairs, then live ones made while the sweep goes on.
+        (build 50000 '())
+        (set! kept (cons (build 100 '()) kept))
+        (build 50000 '())
+        (display (sum (car kept) 0))
+        (newline)
+        (round (- k 1)))))
+(round 5)
+
+(define (total l acc) (if (null? l) acc (total (cdr l) (+ acc (sum (car l) 0)))))
+(display (total kept 0))
+(newline)
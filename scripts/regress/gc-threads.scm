@@ -0,0 +1,22 @@
+; The marking threads are kept between major collections, and are
+; started or stopped as their number changes. Each round grows the heap
+; through a few major collections, whose structure comes out whole.
+; Expected: 450515500 five times
+
+(define (build n acc)
+  (if (eq? n 0) acc (build (- n 1) (cons (list n (cons n n)) acc))))
+(define (sum l acc)
+  (if (null? l) acc (sum (cdr l) (+ acc (car (car l))))))
+
+(define kept '())
+(define (round threads)
+  (gc-set-threads threads)
+  (set! kept (build 1000 (build 30000 '())))
+  (display (sum kept 0))
+  (newline))
+
+(round 4)
+(round 4)
+(round 2)
+(round 8)
+(round 1)
@@ -0,0 +1,33 @@
+; The cached binding of a global reference follows redefinition, set!,
+; a definition made after the reference was compiled, and the env the
+; code is evaluated in.
+; Expected: 2 11 101 now-bound 1 a shadowed 1 3
+
+(define (show x) (display x) (newline))
+
+(define (f) (g 1))
+(define (g x) (+ x 1))
+(show (f))
+(define (g x) (+ x 10))
+(show (f))
+(set! g (lambda (x) (+ x 100)))
+(show (f))
+
+(define (h) later)
+(define later 'now-bound)
+(show (h))
+
+(define (use-car l) (car l))
+(show (use-car '(1 2)))
+(define env (null-environment 5))
+(eval '(define (k) (car '(a b))) env)
+(show (eval '(k) env))
+(eval '(define (car x) 'shadowed) env)
+(show (eval '(k) env))
+(show (use-car '(1 2)))
+
+(define counter 0)
+(define (bump) (set! counter (+ counter 1)) counter)
+(bump)
+(bump)
+(show (bump))
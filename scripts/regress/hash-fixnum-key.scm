@@ -0,0 +1,11 @@
+; Dict keys must be symbols: a fixnum key is an error, not a crash.
+; Expected: prints ok, then FATAL -- not a symbol
+
+(define h (make-hash))
+(hash-set! h 'a 1)
+(display (hash-ref h 'a))
+(display " ok")
+(newline)
+(hash-set! h 1 2)
+(display "unreachable")
+(newline)
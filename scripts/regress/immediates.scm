@@ -0,0 +1,23 @@
+; Fixnums, booleans, nil and the unspecified value are immediates: equal
+; ones are eq?, they keep their type and value in data structures and
+; across collections, and they answer the type predicates.
+; Expected: (#t #t #t #t #t) (#t #f #f) (-7 0 2000000000) (1000 (#t #f) ()) 499500
+
+(define (show x) (display x) (newline))
+
+(show (list (eq? 12345 (+ 12340 5)) (eq? -3 (- 0 3)) (eq? #t (< 1 2))
+            (eq? '() (cdr '(1))) (unspecified? (if #f #f))))
+(show (list (integer? 5) (integer? #t) (boolean? '())))
+(show (list (- 3 10) (+ -5 5) (+ 1000000000 1000000000)))
+
+(define h (make-hash))
+(hash-set! h 'n 1000)
+(hash-set! h 'flags (list #t #f))
+(hash-set! h 'none '())
+(define v (make-vector 1000 0))
+(define (fill i) (if (< i 1000) (begin (vector-set! v i i) (fill (+ i 1)))))
+(fill 0)
+(gc)
+(show (list (hash-ref h 'n) (hash-ref h 'flags) (hash-ref h 'none)))
+(define (vsum i acc) (if (< i 1000) (vsum (+ i 1) (+ acc (vector-ref v i))) acc))
+(show (vsum 0 0))
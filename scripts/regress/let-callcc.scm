@@ -0,0 +1,30 @@
+; Each entry of a binding form makes fresh bindings, even when its
+; procedure's env is captured: the closures made on each return to the
+; continuation keep the value of their own entry.
+; Expected: (2 1 0) (12 11 10) (2 1 0)
+
+(define (let-entries)
+  (let ((saved '()) (k #f))
+    (let ((n (call/cc (lambda (c) (set! k c) 0))))
+      (let ((x n))
+        (set! saved (cons (lambda () x) saved))
+        (if (< n 2) (k (+ n 1)) (map (lambda (f) (f)) saved))))))
+(display (let-entries))
+(newline)
+
+(define (let*-entries)
+  (let ((saved '()) (k #f))
+    (let* ((n (call/cc (lambda (c) (set! k c) 0))) (y (+ n 10)))
+      (set! saved (cons (lambda () y) saved))
+      (if (< n 2) (k (+ n 1)) (map (lambda (f) (f)) saved)))))
+(display (let*-entries))
+(newline)
+
+(define (letrec-entries)
+  (let ((saved '()) (k #f))
+    (let ((n (call/cc (lambda (c) (set! k c) 0))))
+      (letrec ((get (lambda () n)))
+        (set! saved (cons get saved))
+        (if (< n 2) (k (+ n 1)) (map (lambda (f) (f)) saved))))))
+(display (letrec-entries))
+(newline)
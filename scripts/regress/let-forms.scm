@@ -0,0 +1,59 @@
+; let, let*, letrec, named let and do: scoping of the inits, inner
+; defines, loops in constant stack space, and closures made in a loop
+; which keep the bindings of their own turn.
+; Expected: (1 10) (1 1) #t (100 (3 4)) 500000500000 5000050000 (2 1 0)
+; (3 10) 3 5 012 012 7 (2 1 0 1 0 0) (2 1)
+
+(define (show x) (display x) (newline))
+
+(define x 10)
+(show (let ((x 1) (y x)) (list x y)))
+(show (let* ((x 1) (y x)) (list x y)))
+(show (letrec ((ev? (lambda (n) (if (eq? n 0) #t (od? (- n 1)))))
+               (od? (lambda (n) (if (eq? n 0) #f (ev? (- n 1))))))
+        (ev? 100)))
+
+(define (f a)
+  (let ((b (+ a 1)))
+    (let* ((a (+ b 1)) (b (+ a 1)))
+      (let ((g (lambda () (list a b))))
+        (let ((a 100))
+          (list a (g)))))))
+(show (f 1))
+
+(define (sum n)
+  (let loop ((i 0) (acc 0)) (if (< n i) acc (loop (+ i 1) (+ acc i)))))
+(show (sum 1000000))
+(define (dosum n) (do ((i 0 (+ i 1)) (acc 0 (+ acc i))) ((< n i) acc)))
+(show (dosum 100000))
+(define (docl)
+  (let ((fs '()))
+    (do ((i 0 (+ i 1)))
+        ((eq? i 3) (map (lambda (f) (f)) fs))
+      (set! fs (cons (lambda () i) fs)))))
+(show (docl))
+
+(define (shadow x) (let ((x (+ x 1))) (set! x (+ x 1)) x))
+(show (list (shadow 1) x))
+(define (inner-def) (let ((a 1)) (define b 2) (define (c) (+ a b)) (c)))
+(show (inner-def))
+(define (after-let) (let ((q 1)) q) (define q 5) q)
+(show (after-let))
+
+(let loop ((i 0)) (if (< i 3) (begin (display i) (loop (+ i 1)))))
+(newline)
+(do ((i 0 (+ i 1))) ((eq? i 3)) (display i))
+(newline)
+(define (empty) (let () 7))
+(show (empty))
+
+(define (nested n)
+  (let outer ((i 0) (acc '()))
+    (if (eq? i n)
+        acc
+        (outer (+ i 1)
+               (let inner ((j 0) (a acc))
+                 (if (eq? j i) a (inner (+ j 1) (cons j a))))))))
+(show (nested 4))
+(define (lcap) (let ((a 1)) (let ((f (lambda () a))) (let ((a 2)) (list a (f))))))
+(show (lcap))
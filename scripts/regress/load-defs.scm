@@ -0,0 +1,2 @@
+; Loaded by load-in-procedure.scm
+(define x 'local)
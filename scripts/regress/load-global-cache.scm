@@ -0,0 +1,17 @@
+; The global cache of a reference site is kept per env, as only some
+; applications of a procedure may have loaded definitions into theirs.
+; Run from the top of the tree.
+; Expected: local global local global
+
+(define x 'global)
+
+(define (g b)
+  (if b (load "scripts/regress/load-defs.scm"))
+  (lambda () x))
+
+(define with-defs (g #t))
+(define without-defs (g #f))
+(display (with-defs)) (newline)
+(display (without-defs)) (newline)
+(display (with-defs)) (newline)
+(display ((g #f))) (newline)
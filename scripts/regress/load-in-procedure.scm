@@ -0,0 +1,22 @@
+; Definitions loaded by a procedure go into its own env, even when its
+; locals are kept on the stack. Run from the top of the tree.
+; Expected: local global global ((global 5 1) local 5 0)
+
+(define x 'global)
+
+(define (f b)
+  (if b (load "scripts/regress/load-defs.scm"))
+  x)
+
+(display (f #t)) (newline)
+(display (f #f)) (newline)
+(display x) (newline)
+
+(define (outer y)
+  (let loop ((i 0))
+    (if (eq? i 0)
+        (begin (load "scripts/regress/load-defs.scm")
+               (cons (loop 1) (list x y i)))
+        (list x y i))))
+
+(display (outer 5)) (newline)
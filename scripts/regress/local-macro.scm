@@ -0,0 +1,15 @@
+; Macros are only expanded from the toplevel env: the uses of a name
+; bound in a body are analysed as calls, so defining a macro there is
+; refused when the body is analysed.
+; Expected: 3, then FATAL -- define -- a macro can't be defined in a body
+
+(define m (lambda-syntax (x) x))
+(define (g) (m 3))
+(display (g))
+(newline)
+
+(define (f)
+  (define m (lambda-syntax (x) x))
+  (m 3))
+(display (f))
+(newline)
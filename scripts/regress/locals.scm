@@ -0,0 +1,40 @@
+; Local variables are resolved to a depth and a slot: inner lambdas see
+; the right binding through several levels, a set! reaches the binding
+; it names, and an inner define shadows a global even for references
+; analysed before it.
+; Expected: (1 2 3 4) (x 10 y) 3 mine (late 1) 5
+
+(define (show x) (display x) (newline))
+
+(define (levels a)
+  (lambda (b)
+    (lambda (c)
+      (lambda (d) (list a b c d)))))
+(show ((((levels 1) 2) 3) 4))
+
+(define x 'x)
+(define (shadow y)
+  (list x ((lambda (x) (+ x y)) 5) ((lambda (y) y) 'y)))
+(show (shadow 5))
+
+(define (counter)
+  (define n 0)
+  (lambda ()
+    ((lambda () (set! n (+ n 1))))
+    n))
+(define c (counter))
+(c)
+(c)
+(show (c))
+
+(define (own-car p) (define car (lambda (p) 'mine)) (car p))
+(show (own-car '(1 2)))
+
+(define (early)
+  (define (get) later)
+  (define later (list 'late (car '(1))))
+  (get))
+(show (early))
+
+(define (assign x) (set! x (+ x 1)) ((lambda () (set! x (+ x 3)))) x)
+(show (assign 1))
@@ -0,0 +1,23 @@
+; A macro use in a procedure body is expanded once, not on each call,
+; and expanded again when the macro is rebound, also for a procedure
+; bound under another name.
+; Expected: (2 12 22) 1 3 (1 1) 1
+
+(define (show x) (display x) (newline))
+
+(define expansions 0)
+(define twice
+  (lambda-syntax (e)
+    (set! expansions (+ expansions 1))
+    `(begin ,e ,e)))
+(define (f x) (twice (set! x (+ x 1))) x)
+(show (list (f 0) (f 10) (f 20)))
+(show expansions)
+
+(define twice (lambda-syntax (e) `(begin ,e ,e ,e)))
+(show (f 0))
+
+(define g f)
+(define twice (lambda-syntax (e) e))
+(show (list (g 0) (f 0)))
+(show expansions)
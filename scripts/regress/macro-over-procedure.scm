@@ -0,0 +1,13 @@
+; Calls compiled while a name was a procedure, or unbound, are analysed
+; again once the name is bound to a macro.
+; Expected: 7 (expanded 7) skipped (later 1)
+
+(define (qmac x) x)
+(define (use) (qmac 7))
+(display (use)) (newline)
+(define qmac (lambda-syntax (x) `(list 'expanded ,x)))
+(display (use)) (newline)
+(define (use2 b) (if b (later 1) 'skipped))
+(display (use2 #f)) (newline)
+(define later (lambda-syntax (x) `(list 'later ,x)))
+(display (use2 #t)) (newline)
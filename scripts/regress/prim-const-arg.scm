@@ -0,0 +1,21 @@
+; An inlined primitive whose last argument is a constant takes it as an
+; operand: its result is the same on the fast path, on the slow path,
+; and once the primitive's name is rebound.
+; Expected: (6 4 #t #f #t 1 (5) (a . b)) (1.5 -0.5) 100000 (5 (plus 1))
+
+(define (show x) (display x) (newline))
+
+(define v (vector 1 2 3))
+(define (consts x)
+  (list (+ x 1) (- x 1) (< x 10) (< x 5) (eq? x 5)
+        (vector-ref v 0) (cons x '()) (cons 'a 'b)))
+(show (consts 5))
+(show (list (+ 0.5 1) (- 0.5 1)))
+
+(define (count n) (if (< n 100000) (count (+ n 1)) n))
+(show (count 0))
+
+(define (incr x) (+ x 1))
+(define (incr-list x) (list x (incr x)))
+(define + (lambda (a b) (list 'plus b)))
+(show (incr-list 5))
@@ -0,0 +1,32 @@
+; Each inlined primitive gives the result of the primitive, on fixnums
+; and on the flonums which take the slow path, in operand and in tail
+; position.
+; Expected: 3 3.5 -7 0.5 #t #f x (y) (1 . 2)
+; (#t #f #t #f #t #f) 3 -10000 (3 . 4)
+
+(define (show x) (display x) (newline))
+
+(define (add a b) (+ a b))
+(define (sub a b) (- a b))
+(define (lt a b) (< a b))
+(show (add 1 2))
+(show (add 1.5 2))
+(show (sub 3 10))
+(show (sub 2.5 2))
+(show (lt 1 2))
+(show (lt 3 2))
+
+(define (first l) (car l))
+(show (first '(x y)))
+(show (cdr '(x y)))
+(show (cons 1 2))
+(show (list (eq? 'a 'a) (eq? 1 2) (null? '()) (null? 1)
+            (pair? '(1)) (pair? 1)))
+(define v (vector 1 2 3))
+(define (third v) (vector-ref v 2))
+(show (third v))
+
+(define (deep n) (if (eq? n 0) 0 (- (deep (- n 1)) 1)))
+(show (deep 10000))
+(define (nested a b) (cons (+ a (car b)) (cdr (cons a (+ (car b) 2)))))
+(show (nested 1 '(2)))
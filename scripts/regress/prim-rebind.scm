@@ -0,0 +1,13 @@
+; Inlined primitives fall back to a call of whatever the name is bound to.
+; Expected: 1 3 mine (1 2) 3 1.5
+
+(define (f x) (car x))
+(define (g) (+ 1 2))
+(display (f '(1 2))) (newline)
+(display (g)) (newline)
+(define car (lambda (x) 'mine))
+(display (f '(1 2))) (newline)
+(define + (lambda (a b) (list a b)))
+(display (g)) (newline)
+(display (vector-ref (vector 1 2 3) 2)) (newline)
+(display (- 2.5 1)) (newline)
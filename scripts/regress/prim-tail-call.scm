@@ -0,0 +1,13 @@
+; A tail call to a primitive's name which was rebound is still a proper
+; tail call, deeper than the stack would hold.
+; Expected: done done
+
+(define (count n) (if (eq? n 0) 'done (car (- n 1))))
+(define car count)
+(display (count 10000000))
+(newline)
+
+(define (down n) (if (eq? n 0) 'done (+ n -1)))
+(define (+ a b) (down (- a 1)))
+(display (down 10000000))
+(newline)
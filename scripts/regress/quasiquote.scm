@@ -0,0 +1,29 @@
+; Quasiquote templates: splicing at any place, dotted tails, nested
+; levels which are only partly evaluated, constant parts shared between
+; evaluations and the rest freshly made, so that mutating a result
+; changes neither the template nor a spliced list.
+; Expected: (a b c) (a 5 c) (1 2 3) (0 1 2 3 4) (0 4) (1 2 3 1 2 3 . 5)
+; (a . 5) 5 (1 (quasiquote (2 (unquote (3 5)))))
+; (1 (quasiquote (2 (unquote (3 1 2 3)))))
+; (1 (quasiquote (2 (unquote-splicing (3 1 2 3))))) #t #f (k (a b) 5)
+; (1 2 3) ((5) ((5)))
+
+(define (show x) (display x) (newline))
+(define x 5) (define l '(1 2 3)) (define e '())
+(show `(a b c))
+(show `(a ,x c))
+(show `(,@l))
+(show `(0 ,@l 4))
+(show `(0 ,@e 4))
+(show `(,@l ,@l . ,x))
+(show `(a . ,x))
+(show `,x)
+(show `(1 `(2 ,(3 ,x))))
+(show `(1 `(2 ,(3 ,@l))))
+(show `(1 `(2 ,@(3 ,@l))))
+(define (f) `(k (a b) ,x))
+(show (eq? (cadr (f)) (cadr (f))))
+(show (eq? (f) (f)))
+(define m (f)) (set-car! m 'z) (show (f))
+(define s `(,@l)) (set-car! s 99) (show l)
+(show `((,x) ((,x))))
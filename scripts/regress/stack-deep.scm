@@ -0,0 +1,11 @@
+; The shadow stack holds a few hundred thousand pending calls, made
+; directly or through map.
+; Expected: 300000 300001
+
+(define (count n) (if (eq? n 0) 0 (+ 1 (count (- n 1)))))
+(display (count 300000))
+(newline)
+
+(define (mk n) (if (eq? n 0) '() (cons n (mk (- n 1)))))
+(display (car (map (lambda (x) (+ x 1)) (mk 300000))))
+(newline)
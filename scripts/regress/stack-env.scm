@@ -0,0 +1,35 @@
+; Procedures without inner lambdas keep their env on the stack, and the
+; others in the heap: both keep their values across collections, deep
+; recursion and calls from one kind to the other.
+; Expected: 210 (3 2 1) 55 (12 12) 3
+
+(define (show x) (display x) (newline))
+
+(define (sum-to n acc)
+  (if (eq? n 0)
+      (begin (gc) acc)
+      (sum-to (- n 1) (+ acc n))))
+(show (sum-to 20 0))
+
+(define (keep a b c)
+  (define l (list a b c))
+  (gc)
+  l)
+(show (keep 3 2 1))
+
+(define (deep n)
+  (if (eq? n 0)
+      (begin (gc) 0)
+      (+ n (car (list (deep (- n 1)))))))
+(show (deep 10))
+
+(define (adder n) (lambda (x) (+ x n)))
+(define (apply-both f g x) (list (f x) (g x)))
+(define add2 (adder 2))
+(show (apply-both add2 (lambda (y) (add2 y)) 10))
+
+(define (outer x)
+  (define (inner y) (+ x y))
+  (define (plain a b) (+ a b))
+  (plain (inner 1) (- x x)))
+(show (outer 2))
@@ -0,0 +1,8 @@
+; Running out of shadow stack is reported, instead of writing past it.
+; Expected: before, then FATAL -- stack overflow
+
+(define (endless n) (+ 1 (endless n)))
+(display 'before)
+(newline)
+(endless 0)
+(display 'not-reached)
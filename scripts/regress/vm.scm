@@ -0,0 +1,33 @@
+; The bytecode vm: deep non-tail recursion, tail calls in constant stack
+; space, even through rest formals and apply, and calls whose operands
+; are themselves calls, conditionals and sequences.
+; Expected: 20000 #t 4 (20001 2) (1 2 3) 7 ((1 2) 3) done
+
+(define (show x) (display x) (newline))
+
+(define (count n) (if (eq? n 0) 0 (+ 1 (count (- n 1)))))
+(show (count 20000))
+
+(define (odd2 n) (if (eq? n 0) #f (even2 (- n 1) 'x 'y)))
+(define (even2 n . junk) (if (eq? n 0) #t (odd2 (- n 1))))
+(show (odd2 1000001))
+
+(define (r a . rest) (if (null? rest) a (apply r rest)))
+(show (r 1 2 3 4))
+
+(define (mk n) (if (eq? n 0) '() (cons n (mk (- n 1)))))
+(define l (map (lambda (x) (+ x 1)) (mk 20000)))
+(define (last l) (if (null? (cdr l)) (car l) (last (cdr l))))
+(show (list (car l) (last l)))
+
+(define (outer a) (lambda (b) (lambda (c) (list a b c))))
+(show (((outer 1) 2) 3))
+
+(define (pick b) (+ (if b 3 4) (begin 'ignored 3)))
+(show (+ (pick #f) (- (pick #t) 6)))
+
+(define (pair-up a b) (cons (list a b) (list (+ a b))))
+(show (pair-up (car '(1)) (car (cdr '(1 2)))))
+
+(define (spin n) (if (eq? n 0) 'done (spin (- n 1))))
+(show (spin 10000000))
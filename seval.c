@@ -1,16 +1,23 @@
 
+#include <string.h>
+#include <setjmp.h>
 #include "sgc.h"
 #include "seval.h"
 #include "seval_impl.h"
 #include "slib.h"
 #include "slang.h"
+#include "scomp.h"
 
 extern void sparse_init();
 
-static obj_t *symbol_begin;  // For lambda transform...
-
-static obj_t *eval_symbol(obj_t **frame);
-static obj_t *apply_procedure(obj_t **frame);
+static obj_t *vm_execute(obj_t **frame);
+static obj_t *prepare_closure(obj_t **sp, obj_t *proc);
+static void check_arity(obj_t **sp, obj_t *code, long argc);
+static obj_t *make_defs_env(obj_t **sp, obj_t **frame, obj_t *code);
+static obj_t *bind_arguments(obj_t **sp, obj_t *proc, long argc);
+static void bind_stack_slots(obj_t **frame, obj_t **sp, obj_t *proc,
+                             long argc);
+static obj_t *env_at_depth(obj_t **frame, long depth);
 
 // Intern some symbols for later use.
 void
@@ -29,8 +36,6 @@ seval_init()
 
     obj_t **frame = gc_get_stack_base();
 
-    symbol_begin = symbol_intern(frame, "begin");
-
     // The very first frame.
     frame = frame_extend(frame, 0, FR_CLEAR_SLOTS);
     frame_set_env(frame, environ_wrap(frame, nil_wrap()));
@@ -62,6 +67,10 @@ obj_t **frame_extend(obj_t **old_frame, size_t size,
 
     real_size = size + NB_FRAME_META_SLOTS;
     new_frame = old_frame - real_size;
+    if (SGC_STACK_OVERFLOWP(new_frame)) {
+        // A trace of the whole stack would be useless.
+        fatal_error("stack overflow", NULL);
+    }
 
     // Initialize clear every slots in the new frame to be NULL
     // Including the environment slot and the previous frame ptr slot.
@@ -74,10 +83,15 @@ obj_t **frame_extend(obj_t **old_frame, size_t size,
         }
     }
 
-    // Save previous frame pointer on the new frame.
+    // Save previous frame pointer on the new frame. The meta slots are
+    // always written, so that the collector never sees a stale value in
+    // them.
     if (flags & FR_SAVE_PREV) {
         frame_set_prev(new_frame, old_frame);
     }
+    else {
+        frame_set_prev(new_frame, NULL);
+    }
 
     if (flags & FR_EXTEND_ENV) {
         // Extend and save the previous environment pointer on the new frame.
@@ -87,6 +101,9 @@ obj_t **frame_extend(obj_t **old_frame, size_t size,
         // Or just using the previous environment.
         frame_set_env(new_frame, old_env);
     }
+    else {
+        frame_set_env(new_frame, NULL);
+    }
 
     return new_frame;
 }
@@ -94,13 +111,13 @@ obj_t **frame_extend(obj_t **old_frame, size_t size,
 obj_t **
 frame_prev(obj_t **frame)
 {
-    return (obj_t **)frame[1];
+    return SGC_UNTAG_FRAME(frame[1]);
 }
 
 void
 frame_set_prev(obj_t **frame, obj_t **prev_frame)
 {
-    frame[1] = (obj_t *)prev_frame;
+    frame[1] = prev_frame ? SGC_TAG_FRAME(prev_frame) : NULL;
 }
 
 obj_t *
@@ -123,310 +140,731 @@ frame_ref(obj_t **frame, long index)
 
 
 // main entrance for eval.
-// For tail's purpose, eval-related things are all placed here.
+// The expression is analysed into a node tree, compiled into bytecode
+// and then run by the vm.
 // @see frame_extend() for frame layout information and calling convention.
 obj_t *
 eval_frame(obj_t **frame)
 {
-    obj_t *self;
-    obj_t *car, *cdr, *w, *x, *v;
-    // When in primitive-apply or macro expension, this will be false.
-    // Otherwise, it will be set to true on normal routine.
-    bool_t args_need_eval;
-
-tailcall:
-    self = *frame_ref(frame, 0);
-    switch (get_type(self)) {
-
-    case TP_PAIR:
-        car = pair_car(self);
-        cdr = pair_cdr(self);
-        args_need_eval = 1;
-
-        if (symbolp(car)) {
-            // Handling special form / macros
-            obj_t *binding = environ_lookup(frame_env(frame),
-                    car, EL_LOOK_OUTER);
-            if (binding) {
-                obj_t *syntax = pair_cdr(binding);
-                obj_t *tailp;
-                obj_t *retval;
-                if (specformp(syntax)) {
-                    obj_t **ex_frame = frame_extend(frame, 1,
-                            FR_SAVE_PREV | FR_CONTINUE_ENV);
-                    *frame_ref(ex_frame, 0) = cdr;
-
-                    // Call the special form.
-                    retval = specform_unwrap(syntax)(ex_frame, &tailp);
-                    if (slang_tailp(tailp)) {
-                        *frame_ref(frame, 0) = retval;
-                        goto tailcall;
-                    }
-                    else {
-                        return retval;
-                    }
-                }
-                else if (macrop(syntax)) {
-                    *frame_ref(frame, 0) = macro_expand(frame, syntax, cdr);
-                    goto tailcall;
-                }
-            }
-        }
-
-        // Is normal procedure OR closure application.
-        // 1. Get the callable
-        // 2. Unpack and evaluate each arg and prepare for application.
-        // The prepared frame will be like this:
-        // [env, dumped-fp, argn, ..., arg0, callable]
-        {
-            obj_t *proc;
-            obj_t *iter;
-            obj_t *retval;
-            obj_t **orig_frame = frame;
-            obj_t *orig_env = frame_env(frame);
-            long argc;
-            long i;
-            {
-                // Get the procedure/closure
-                obj_t **proc_frame = frame_extend(frame, 1,
-                        FR_SAVE_PREV | FR_CONTINUE_ENV);
-                *frame_ref(proc_frame, 0) = car;
-                proc = eval_frame(proc_frame);
-
-                // Check early if it's not a callable
-                if (!procedurep(proc) && !closurep(proc) &&
-                        !continuationp(proc)) {
-                    fatal_error("not a callable", frame);
-                }
+    *frame_ref(frame, 0) = slang_analyze(frame, nil_wrap());
+    *frame_ref(frame, 0) = scomp_toplevel(frame);
+    return vm_execute(frame);
+}
 
-                // Push the callable (whatever it is)
-                // on the frame, to avoid GC.
-                --frame;
-                *frame = proc;
-// XXX
-// XXX: WARNING -- Frame is UNUSABLE during application preparation
-// XXX
-            }
+// The dispatch loop uses computed goto when the compiler supports it,
+// which saves a bound check and lets each handler jump to the next one.
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO
+#endif
+
+#ifdef VM_COMPUTED_GOTO
+#define VM_CASE(op) L_##op:
+#define VM_DISPATCH() goto *dispatch_table[*pc++]
+#else
+#define VM_CASE(op) case op:
+#define VM_DISPATCH() continue
+#endif
+
+// Both are fixnums kept in the word itself, @see fixnum_wrap(). Their
+// sum or difference can't overflow a long.
+#define IMM_FIXNUMS2P(a, b) ((uintptr_t)(a) & (uintptr_t)(b) & IMM_FIXNUM_TAG)
+#define IMM_FIXNUM_VAL(o) ((intptr_t)(o) >> 1)
+
+// A closure frame pushed by the vm holds its code and where to resume
+// the caller, which is the saved previous frame.
+#define FRAME_CODE 0
+#define FRAME_RET_PC 1  // offset in the caller's insns
+#define FRAME_RET_ARGC 2  // args to pop from the caller's stack
+#define FRAME_ESCAPE 3  // the continuation of call/ec, or NULL
+#define NB_CALL_SLOTS 4
+
+// The running vm activations, innermost first. An escape continuation
+// of an outer one unwinds the C stack of the inner ones with a longjmp,
+// the escapes within an activation are only made on the shadow stack.
+// The continuations name their activation by serial: a base frame address
+// is reused by the next activation made from the same caller frame.
+struct vm_activation {
+    long serial;
+    obj_t **frame;  // when calling out of the vm
+    jmp_buf unwind;
+    struct vm_activation *outer;
+};
+
+static struct vm_activation *vm_current = NULL;
+static long vm_last_serial = 0;
+static obj_t *vm_unwind_cont;
+static obj_t *vm_unwind_value;
+
+// Escape into an outer activation, where the continuation is resumed.
+static void
+vm_unwind(obj_t *cont, obj_t *value, obj_t **sp)
+{
+    struct vm_activation *act;
+    for (act = vm_current; act; act = act->outer) {
+        if (act->serial == econt_activation(cont)) {
+            vm_current = act;
+            vm_unwind_cont = cont;
+            vm_unwind_value = value;
+            longjmp(act->unwind, 1);
+        }
+    }
+    fatal_error("continuation already out of scope", sp);
+}
 
-            // Get the argument list.
-            // Two pass -- 1: get argc and fill the frame slots with
-            // list items waiting for evaluation.
-apply_reentry:
-            argc = 0;
-            for (iter = cdr; pairp(iter); iter = pair_cdr(iter)) {
-                ++argc;
-                --frame;
-                *frame = pair_car(iter);
-            }
-            if (!nullp(iter)) {
-                fatal_error("not a well-formed list", frame);
-            }
+// Run the code object on frame_ref(frame, 0).
+// The operand stack grows downward from the frame, which makes everything
+// pushed on it visible to the gc. A call to a closure in tail position
+// reuses the current frame, other calls push a new frame and the vm keeps
+// running there: the recursion depth is only bounded by the shadow stack.
+// All the state of the evaluation lives between sp and the base frame,
+// and call/cc copies it into a continuation which can be resumed as long
+// as this vm_execute() is running. call/ec is cheaper: its continuation
+// returns from the frame made for the proc, if that is still running.
+static obj_t *
+vm_execute(obj_t **frame)
+{
+#ifdef VM_COMPUTED_GOTO
+    static void *dispatch_table[NB_OPCODES] = {
+        &&L_OP_CONST, &&L_OP_LREF, &&L_OP_GREF, &&L_OP_LSET, &&L_OP_GSET,
+        &&L_OP_SREF, &&L_OP_SSET, &&L_OP_DEFINE, &&L_OP_POP, &&L_OP_JUMP,
+        &&L_OP_JUMPF, &&L_OP_JUMPT, &&L_OP_JUMPEQ, &&L_OP_CALL,
+        &&L_OP_TAILCALL, &&L_OP_CLOSURE, &&L_OP_MACRO, &&L_OP_CONS,
+        &&L_OP_APPEND, &&L_OP_PRIM, &&L_OP_PRIMK,
+        &&L_OP_RETURN
+    };
+#endif
+    obj_t *code, *binding, *retval, *proc, *escape = NULL;
+    obj_t **consts, **sp, **target;
+    obj_t **base = frame;
+    long *insns, *pc;
+    long argc, ret_pc;
+    bool_t tail;
+    struct vm_activation act;
+
+    act.serial = ++vm_last_serial;
+    act.frame = frame;
+    act.outer = vm_current;
+    vm_current = &act;
+    if (setjmp(act.unwind)) {
+        // An inner activation escaped to here.
+        proc = vm_unwind_cont;
+        retval = vm_unwind_value;
+        frame = act.frame;
+        goto do_escape;
+    }
 
-            // -- 2: move each item into evaluatin position and eval.
-            // Note that we are evaluating in reversed order (right to left)
-            // If we come here from the special apply proc,
-            // args_need_eval will be false since they are already evaluated.
-            if (args_need_eval) {
-                for (i = 0; i < argc; ++i) {
-                    // Evaluate this argument on a new frame
-                    obj_t **arg_frame = frame_extend(frame, 1, FR_CLEAR_SLOTS);
-                    // Since the frame is unusable, we need to manually
-                    // set its environment and prev-frame-ptr
-                    frame_set_prev(arg_frame, orig_frame);
-                    frame_set_env(arg_frame, orig_env);
-
-                    *frame_ref(arg_frame, 0) = frame[i];
-                    retval = eval_frame(arg_frame);
-
-                    // Push the result back to the argument position.
-                    frame[i] = retval;
+vm_enter:
+    code = *frame_ref(frame, FRAME_CODE);
+    insns = code_insns(code);
+    consts = vector_ref(code_consts(code), 0);
+    pc = insns;
+    sp = code_stack_envp(code) ? frame - code_nb_slots(code) : frame;
+
+#ifdef VM_COMPUTED_GOTO
+    VM_DISPATCH();
+#else
+    for (;;) {
+        switch (*pc++) {
+#endif
+
+    VM_CASE(OP_CONST)
+        *--sp = consts[pc[0]];
+        pc += 1;
+        VM_DISPATCH();
+
+    VM_CASE(OP_LREF)
+        retval = *environ_ref(env_at_depth(frame, pc[0]), pc[1]);
+        if (!retval)
+            fatal_error("unbound variable", sp);
+        *--sp = retval;
+        pc += 2;
+        VM_DISPATCH();
+
+    VM_CASE(OP_GREF)
+        // The env of each application may hold its own definitions,
+        // made by load, so the cache is only valid for the same env.
+        if (pc[2] != environ_version ||
+                consts[pc[1] + 1] != frame_env(frame)) {
+            binding = environ_lookup(frame_env(frame), consts[pc[0]],
+                                     EL_LOOK_OUTER);
+            if (!binding)
+                fatal_error("unbound variable", sp);
+            if (syntaxp(pair_cdr(binding)))
+                fatal_error("bad syntax", sp);
+            vector_set(code_consts(code), pc[1], binding);
+            vector_set(code_consts(code), pc[1] + 1, frame_env(frame));
+            pc[2] = environ_version;
+        }
+        *--sp = pair_cdr(consts[pc[1]]);
+        pc += 3;
+        VM_DISPATCH();
+
+    VM_CASE(OP_LSET)
+        environ_set_slot(env_at_depth(frame, pc[0]), pc[1], *sp);
+        *sp = unspec_wrap();
+        pc += 2;
+        VM_DISPATCH();
+
+    VM_CASE(OP_GSET)
+        if (pc[2] != environ_version ||
+                consts[pc[1] + 1] != frame_env(frame)) {
+            binding = environ_lookup(frame_env(frame), consts[pc[0]],
+                                     EL_LOOK_OUTER);
+            if (!binding)
+                fatal_error("set! -- No such binding", sp);
+            vector_set(code_consts(code), pc[1], binding);
+            vector_set(code_consts(code), pc[1] + 1, frame_env(frame));
+            pc[2] = environ_version;
+        }
+        binding = consts[pc[1]];
+        slang_note_rebind(pair_cdr(binding), *sp);
+        if (syntaxp(*sp))
+            ++environ_version;
+        pair_set_cdr(binding, *sp);
+        *sp = unspec_wrap();
+        pc += 3;
+        VM_DISPATCH();
+
+    VM_CASE(OP_SREF)
+        retval = frame[-1 - pc[0]];
+        if (!retval)
+            fatal_error("unbound variable", sp);
+        *--sp = retval;
+        pc += 1;
+        VM_DISPATCH();
+
+    VM_CASE(OP_SSET)
+        frame[-1 - pc[0]] = *sp;
+        *sp = unspec_wrap();
+        pc += 1;
+        VM_DISPATCH();
+
+    VM_CASE(OP_DEFINE)
+        binding = environ_lookup(frame_env(frame), consts[pc[0]],
+                                 EL_DONT_LOOK_OUTER);
+        if (binding) {
+            slang_note_rebind(pair_cdr(binding), *sp);
+            if (syntaxp(*sp))
+                ++environ_version;
+            pair_set_cdr(binding, *sp);
+        }
+        else {
+            slang_note_rebind(NULL, *sp);
+            environ_bind(sp, frame_env(frame), consts[pc[0]], *sp);
+        }
+        *sp = unspec_wrap();
+        pc += 1;
+        VM_DISPATCH();
+
+    VM_CASE(OP_POP)
+        ++sp;
+        VM_DISPATCH();
+
+    VM_CASE(OP_JUMP)
+        pc = insns + pc[0];
+        VM_DISPATCH();
+
+    VM_CASE(OP_JUMPF)
+        if (to_boolean(*sp++))
+            pc += 1;
+        else
+            pc = insns + pc[0];
+        VM_DISPATCH();
+
+    VM_CASE(OP_JUMPT)
+        if (to_boolean(*sp)) {
+            pc = insns + pc[0];
+        }
+        else {
+            ++sp;
+            pc += 1;
+        }
+        VM_DISPATCH();
+
+    VM_CASE(OP_JUMPEQ)
+        if (generic_eq(*sp, consts[pc[0]]))
+            pc = insns + pc[1];
+        else
+            pc += 2;
+        VM_DISPATCH();
+
+    VM_CASE(OP_CLOSURE)
+        retval = closure_wrap(sp, frame_env(frame),
+                              slang_lambda_formals(code_lambda(consts[pc[0]])),
+                              consts[pc[0]]);
+        *--sp = retval;
+        pc += 1;
+        VM_DISPATCH();
+
+    VM_CASE(OP_MACRO)
+        retval = closure_wrap(sp, frame_env(frame),
+                              slang_lambda_formals(code_lambda(consts[pc[0]])),
+                              consts[pc[0]]);
+        *--sp = retval;
+        *sp = macro_wrap(sp, retval);
+        pc += 1;
+        VM_DISPATCH();
+
+    VM_CASE(OP_CONS)
+        retval = pair_wrap(sp, sp[1], sp[0]);
+        *++sp = retval;
+        VM_DISPATCH();
+
+    VM_CASE(OP_APPEND)
+        retval = pair_append(sp, sp[1], sp[0]);
+        *++sp = retval;
+        VM_DISPATCH();
+
+    VM_CASE(OP_PRIMK)
+        // The last arg is a constant, it's pushed without a dispatch.
+        *--sp = consts[pc[0]];
+        pc += 1;
+        // Fall through.
+
+    VM_CASE(OP_PRIM)
+        // The stack is [argn, ..., arg0, proc], what's not handled here
+        // is left to an ordinary call.
+        argc = pc[1];
+        proc = sp[argc];
+        if (proc != consts[pc[2]]) {
+            if (!lib_is_prim_proc(proc, pc[0]))
+                goto prim_call;
+            vector_set(code_consts(code), pc[2], proc);
+        }
+        switch (pc[0]) {
+        case LP_CAR:
+            if (!pairp(sp[0]))
+                goto prim_call;
+            retval = pair_car(sp[0]);
+            break;
+        case LP_CDR:
+            if (!pairp(sp[0]))
+                goto prim_call;
+            retval = pair_cdr(sp[0]);
+            break;
+        case LP_CONS:
+            retval = pair_wrap(sp, sp[1], sp[0]);
+            break;
+        case LP_ADD:
+            if (!IMM_FIXNUMS2P(sp[1], sp[0]))
+                goto prim_call;
+            retval = fixnum_wrap(sp, IMM_FIXNUM_VAL(sp[1]) +
+                                     IMM_FIXNUM_VAL(sp[0]));
+            break;
+        case LP_MINUS:
+            if (!IMM_FIXNUMS2P(sp[1], sp[0]))
+                goto prim_call;
+            retval = fixnum_wrap(sp, IMM_FIXNUM_VAL(sp[1]) -
+                                     IMM_FIXNUM_VAL(sp[0]));
+            break;
+        case LP_LESSTHAN:
+            if (!IMM_FIXNUMS2P(sp[1], sp[0]))
+                goto prim_call;
+            retval = boolean_wrap(IMM_FIXNUM_VAL(sp[1]) <
+                                  IMM_FIXNUM_VAL(sp[0]));
+            break;
+        case LP_EQP:
+            retval = boolean_wrap(generic_eq(sp[1], sp[0]));
+            break;
+        case LP_NULLP:
+            retval = boolean_wrap(nullp(sp[0]));
+            break;
+        case LP_PAIRP:
+            retval = boolean_wrap(pairp(sp[0]));
+            break;
+        case LP_VECTOR_REF:
+            if (!vectorp(sp[1]) || !IMM_FIXNUMS2P(sp[0], sp[0]) ||
+                    IMM_FIXNUM_VAL(sp[0]) < 0 ||
+                    IMM_FIXNUM_VAL(sp[0]) >= (long)vector_length(sp[1]))
+                goto prim_call;
+            retval = *vector_ref(sp[1], IMM_FIXNUM_VAL(sp[0]));
+            break;
+        default:
+            NOT_REACHED();
+        }
+        sp += argc;
+        *sp = retval;
+        pc += 4;
+        VM_DISPATCH();
+
+prim_call:
+        tail = pc[3];
+        pc += 4;
+        goto do_call;
+
+    VM_CASE(OP_RETURN)
+        retval = *sp;
+do_return:
+        if (frame == base) {
+            vm_current = act.outer;
+            return retval;
+        }
+        // Pop the callee frame with the args, and resume the caller.
+        sp = frame_ref(frame, NB_CALL_SLOTS) +
+             fixnum_unwrap(*frame_ref(frame, FRAME_RET_ARGC));
+        ret_pc = fixnum_unwrap(*frame_ref(frame, FRAME_RET_PC));
+        frame = frame_prev(frame);
+        code = *frame_ref(frame, FRAME_CODE);
+        insns = code_insns(code);
+        consts = vector_ref(code_consts(code), 0);
+        pc = insns + ret_pc;
+        *sp = retval;
+        VM_DISPATCH();
+
+do_escape:
+        // Return from the frame of the escape continuation in proc, if
+        // it is still on the chain of the running frames.
+        target = frame;
+        while (target < econt_frame(proc))
+            target = frame_prev(target);
+        if (target != econt_frame(proc) ||
+                *frame_ref(target, FRAME_ESCAPE) != proc) {
+            fatal_error("continuation already out of scope", frame);
+        }
+        frame = target;
+        goto do_return;
+
+    VM_CASE(OP_TAILCALL)
+        tail = 1;
+        argc = *pc++;
+        goto do_call;
+
+    VM_CASE(OP_CALL)
+        tail = 0;
+        argc = *pc++;
+
+do_call:
+        // The stack is now [argn, ..., arg0, callable].
+        proc = sp[argc];
+        if (procedurep(proc)) {
+            if (lib_is_eval_proc(proc)) {
+                // Special case for (eval expr env)
+                obj_t **eval_frame_ptr;
+                if (argc != 2) {
+                    fatal_error("eval should have 2 argument", sp);
                 }
+                if (!environp(sp[0])) {
+                    fatal_error("first argument of eval should "
+                                "be an environment", sp);
+                }
+                // Must create a new frame to hold the given environ.
+                eval_frame_ptr = frame_extend(sp, 1,
+                        FR_CLEAR_SLOTS | FR_SAVE_PREV);
+                frame_set_env(eval_frame_ptr, sp[0]);
+                *frame_ref(eval_frame_ptr, 0) = sp[1];
+                act.frame = frame;
+                retval = eval_frame(eval_frame_ptr);
             }
-
-            // Creating new frame and setting up environment.
-            // Then do the actual application (two cases)
-            {
-                // Since the library function may require the current environ
-                // e.g., (load "filename.scm"), we must attach the environ.
-                frame = frame_extend(frame, 0, FR_CLEAR_SLOTS);
-                frame_set_env(frame, orig_env);
-                frame_set_prev(frame, orig_frame);
-
-                if (procedurep(proc)) {
-                    // Is c-procedure -- just evaluate it.
-                    // Note that we will treat apply/eval differently.
-                    if (lib_is_eval_proc(proc)) {
-                        // Special case for (eval expr env)
-                        if (argc != 2) {
-                            fatal_error("eval should have 2 argument",
-                                        frame);
-                        }
-                        obj_t *expr = *frame_ref(frame, 1);
-                        obj_t *environ = *frame_ref(frame, 0);
-                        if (!environp(environ)) {
-                            fatal_error("first argument of eval should "
-                                        "be an environment", frame);
-                        }
-                        frame = frame_extend(orig_frame, 1,
-                                FR_CLEAR_SLOTS | FR_SAVE_PREV);
-                        // Must create a new frame with the environ
-                        // since we should go back to the origin environ
-                        // later, which could only done by creating a
-                        // new frame to hold the new environ.
-                        *frame_ref(frame, 0) = expr;
-                        frame_set_env(frame, environ);
-                        goto tailcall;
-                    }
-                    else if (lib_is_apply_proc(proc)) {
-                        // Special case for (apply proc args)
-                        if (argc != 2) {
-                            fatal_error("apply should have 2 arguments",
-                                        frame);
-                        }
-                        proc = *frame_ref(frame, 1);
-                        cdr = *frame_ref(frame, 0);
-                        frame = orig_frame;
-                        --frame;
-                        *frame = proc;
-                        args_need_eval = 0;  // args are already evaluated
-                        goto apply_reentry;
-                    }
-                    else {
-                        // Ordinary procedure application
-                        return apply_procedure(frame);
-                    }
+            else if (lib_is_apply_proc(proc)) {
+                // Special case for (apply proc args): unpack the args
+                // in place of the original call and dispatch again.
+                obj_t *args, *iter;
+                if (argc != 2) {
+                    fatal_error("apply should have 2 arguments", sp);
                 }
-                else if (econtp(proc)) {
-                    // Is escaping continuation, call it.
-                    if (argc != 1) {
-                        fatal_error("continuation only accept 1 argument",
-                                    frame);
-                    }
-                    if (!econt_getenv(proc)) {
-                        fatal_error("continuation already out of scope",
-                                    frame);
-                    }
-                    obj_t *aux = *frame_ref(frame, 0);
-                    econt_putaux(proc, aux);
-                    longjmp(*econt_getenv(proc), 1);
+                proc = sp[1];
+                args = sp[0];
+                sp += 2;
+                *sp = proc;
+                argc = 0;
+                for (iter = args; pairp(iter); iter = pair_cdr(iter)) {
+                    ++argc;
+                    if (SGC_STACK_OVERFLOWP(sp - 1))
+                        fatal_error("stack overflow", NULL);
+                    *--sp = pair_car(iter);
                 }
-                else if (closurep(proc)) {
-                    // Is scm-closure: *HARD PART COMES*
-                    // Remember the frame layout:
-                    //   [env, dumped-fp, argn, ..., arg0, callable]
-                    // 1: prepare for an extended env
-                    obj_t *env, *formals, *body;
-                    env = environ_wrap(frame, closure_env(proc));
-                    frame_set_env(frame, env);  // Prevent from gc
-
-                    // 2: push bindings into it -- pos args only for now.
-                    // XXX: arg length check is not done.
-                    formals = closure_formals(proc);
-                    for (i = argc - 1; i >= 0; --i) {
-                        if (symbolp(formals)) {
-                            // pack things into vararg, note it's reversed
-                            obj_t *vararg = nil_wrap();
-                            long rev_i;
-                            for (rev_i = 0; rev_i <= i; ++rev_i) {
-                                obj_t **gc_frame = frame;
-                                SGC_ROOT1(gc_frame, vararg);
-                                vararg = pair_wrap(gc_frame,
-                                                   *frame_ref(frame, rev_i),
-                                                   vararg);
-                            }
-                            environ_bind(frame, env, formals, vararg);
-                            formals = nil_wrap();  // for later to check
-                            break;
-                        }
-                        else if (pairp(formals)) {
-                            environ_bind(frame, env,
-                                         pair_car(formals),
-                                         *frame_ref(frame, i));
-                            formals = pair_cdr(formals);
-                        }
-                        else {
-                            fatal_error("too many args in closure application",
-                                        frame);
-                        }
-                    }
-                    if (symbolp(formals)) {
-                        // Vararg with no args -- make it a empty nil.
-                        environ_bind(frame, env, formals, nil_wrap());
-                    }
-                    else if (!nullp(formals)) {
-                        // Still a pair, which means that we dont have
-                        // enough arguments...
-                        fatal_error("not enough args in closure application",
-                                    frame);
-                    }
-                    // 3: make it a begin.
-                    body = pair_wrap(frame, symbol_begin, closure_body(proc));
-
-                    // 4: unwind the frame since we have finished the binding
-                    // and start to evaluating the begin.
-                    {
-                        frame = orig_frame;
-                        *frame_ref(frame, 0) = body;
-                        frame_set_env(frame, env);
-                        goto tailcall;
-                    }
+                if (!nullp(iter)) {
+                    fatal_error("not a well-formed list", sp);
                 }
-                else {
-                    fatal_error("not a callable", frame);
+                goto do_call;
+            }
+            else if (lib_is_call_ec_proc(proc)) {
+                // Special case for (call/ec proc): call proc with the
+                // continuation, which is bound to the frame made for proc.
+                // That needs a new frame even in tail position.
+                if (argc != 1) {
+                    fatal_error("call/ec should have 1 argument", sp);
                 }
+                retval = econt_wrap(sp, act.serial);
+                sp[1] = sp[0];
+                sp[0] = retval;
+                if (closurep(sp[1]))
+                    escape = retval;
+                tail = 0;
+                goto do_call;
+            }
+            else if (lib_is_call_cc_proc(proc)) {
+                // Special case for (call/cc proc): save the stack above
+                // the call, then call proc with the continuation.
+                if (argc != 1) {
+                    fatal_error("call/cc should have 1 argument", sp);
+                }
+                retval = cont_wrap(sp, sp + 2, frame_ref(base, 1),
+                                   act.serial, frame,
+                                   tail ? -1 : pc - insns);
+                sp[1] = sp[0];
+                sp[0] = retval;
+                goto do_call;
+            }
+            else {
+                // Ordinary procedure application.
+                // Since the library function may require the current
+                // environ e.g., (load "filename.scm"), we must attach it.
+                obj_t **proc_frame;
+                if (code_stack_envp(code) && !code_defs_envp(code) &&
+                        lib_is_load_proc(proc)) {
+                    // The definitions go into the env of the frame, which
+                    // a stack env doesn't have.
+                    act.frame = frame;
+                    code = make_defs_env(sp, frame, code);
+                    pc = code_insns(code) + (pc - insns);
+                    insns = code_insns(code);
+                    consts = vector_ref(code_consts(code), 0);
+                }
+                proc_frame = frame_extend(sp, 0, FR_CLEAR_SLOTS);
+                frame_set_env(proc_frame, frame_env(frame));
+                frame_set_prev(proc_frame, sp + argc + 1);
+                act.frame = frame;
+                retval = proc_unwrap(proc)(proc_frame);
             }
         }
-
-    case TP_SYMBOL:
-        {
-            obj_t *got = eval_symbol(frame);
-            if (syntaxp(got)) {
-                fatal_error("bad syntax", frame);
+        else if (closurep(proc)) {
+            // Is scm-closure: bind the args in a new env and run its code.
+            obj_t *code = closure_body(proc);
+            obj_t *env;
+            obj_t **callee;
+            if (!code_compiledp(code) ||
+                    code_epoch(code) != slang_macro_epoch) {
+                // May expand macros, which runs another activation.
+                act.frame = frame;
+                code = prepare_closure(sp, proc);
+            }
+            check_arity(sp, code, argc);
+            if (code_stack_envp(code)) {
+                // Nothing to allocate, the args are moved into the slots
+                // below the frame (which is reused by a tail call).
+                env = closure_env(proc);
+                callee = tail ? frame :
+                         frame_extend(sp, NB_CALL_SLOTS, FR_DEFAULT);
+                bind_stack_slots(callee, sp, proc, argc);
             }
             else {
-                return got;
+                env = bind_arguments(sp, proc, argc);
+                callee = tail ? frame :
+                         frame_extend(sp, NB_CALL_SLOTS, FR_DEFAULT);
+            }
+            if (!tail) {
+                // The return address is kept over the tail calls.
+                frame_set_prev(callee, frame);
+                *frame_ref(callee, FRAME_RET_PC) =
+                    fixnum_wrap(sp, pc - insns);
+                *frame_ref(callee, FRAME_RET_ARGC) = fixnum_wrap(sp, argc);
+                *frame_ref(callee, FRAME_ESCAPE) = escape;
+                if (escape) {
+                    econt_set_frame(escape, callee);
+                    escape = NULL;
+                }
+            }
+            *frame_ref(callee, FRAME_CODE) = code;
+            frame_set_env(callee, env);
+            frame = callee;
+            goto vm_enter;
+        }
+        else if (contp(proc)) {
+            // Is a full continuation: put the saved stack back, and
+            // resume its frame with the value.
+            if (argc != 1) {
+                fatal_error("continuation only accept 1 argument", sp);
             }
+            if (cont_activation(proc) != act.serial) {
+                fatal_error("continuation resumed out of its evaluation", sp);
+            }
+            retval = sp[0];
+            sp = cont_restore(proc) - 1;
+            frame = cont_frame(proc);
+            if (cont_pc(proc) < 0)
+                goto do_return;
+            code = *frame_ref(frame, FRAME_CODE);
+            insns = code_insns(code);
+            consts = vector_ref(code_consts(code), 0);
+            pc = insns + cont_pc(proc);
+            *sp = retval;
+            VM_DISPATCH();
+        }
+        else if (econtp(proc)) {
+            // Is escaping continuation, unwind to its frame.
+            if (argc != 1) {
+                fatal_error("continuation only accept 1 argument", sp);
+            }
+            retval = sp[0];
+            if (econt_activation(proc) != act.serial)
+                vm_unwind(proc, retval, sp);
+            goto do_escape;
         }
+        else {
+            if (macrop(proc))
+                fatal_error("macro used as a procedure", sp);
+            fatal_error("not a callable", sp);
+        }
+
+        // Pop the args and replace the callable with the result.
+        if (tail)
+            goto do_return;
+        sp += argc;
+        *sp = retval;
+        VM_DISPATCH();
 
-    case TP_PROC:
-    case TP_FIXNUM:
-    case TP_FLONUM:
-    case TP_STRING:
-    case TP_CLOSURE:
-        return self;
-
-    case TP_NIL:
-        fatal_error("empty application", frame);
-        break;
-
-    case TP_VECTOR:
-    case TP_BOOLEAN:
-    case TP_UNSPECIFIED:
-    case TP_UDATA:
-    case TP_ECONT:
-    case TP_EOFOBJ:
-        return self;
+#ifndef VM_COMPUTED_GOTO
+        default:
+            NOT_REACHED();
+        }
     }
+#endif
     NOT_REACHED();
 }
 
+// Get the code of a closure ready to run. It's compiled on the first
+// application, which tells the env's size, and compiled again if a macro
+// used in the body has been rebound since.
 static obj_t *
-eval_symbol(obj_t **frame)
+prepare_closure(obj_t **sp, obj_t *proc)
 {
-    obj_t *key = *frame_ref(frame, 0);
-    obj_t *binding = environ_lookup(frame_env(frame), key, EL_LOOK_OUTER);
-    if (binding)
-        return pair_cdr(binding);
-    else
-        fatal_error("unbound variable", frame);
+    obj_t *code = closure_body(proc);
+    obj_t *lambda = code_lambda(code);
+    obj_t **frame = frame_extend(sp, 1, FR_CLEAR_SLOTS | FR_SAVE_PREV);
+    frame_set_env(frame, closure_env(proc));
+
+    if (code_compiledp(code) &&
+            slang_lambda_stalep(closure_env(proc), lambda)) {
+        // The old code may be still running, leave it to the gc.
+        slang_lambda_reset(frame, lambda);
+    }
+    if (nullp(slang_lambda_code(lambda))) {
+        slang_lambda_set_code(lambda, code_wrap(frame, lambda));
+    }
+    code = slang_lambda_code(lambda);
+    *frame_ref(frame, 0) = code;
+    closure_set_body(proc, code);
+
+    if (code_compiledp(code)) {
+        code_set_epoch(code, slang_macro_epoch);
+    }
+    else {
+        scomp_lambda(frame, code);
+    }
+    return code;
+}
+
+// Give the frame running the code in a stack env an env for the
+// definitions made at runtime, and switch it to the code compiled for
+// that env, which is returned.
+static obj_t *
+make_defs_env(obj_t **sp, obj_t **frame, obj_t *code)
+{
+    obj_t **gc_frame = frame_extend(sp, 1, FR_CLEAR_SLOTS | FR_SAVE_PREV);
+    frame_set_env(gc_frame, frame_env(frame));
+
+    *frame_ref(gc_frame, 0) = environ_wrap_slots(gc_frame, frame_env(frame),
+                                                 0);
+    code = scomp_lambda_defs_env(gc_frame, code);
+    frame_set_env(frame, *frame_ref(gc_frame, 0));
+    *frame_ref(frame, FRAME_CODE) = code;
+    return code;
+}
+
+// Check the number of args against the arity of the code, before
+// anything is bound.
+static void
+check_arity(obj_t **sp, obj_t *code, long argc)
+{
+    char msg[128];
+    long nb_args = code_nb_args(code);
+
+    if (argc < nb_args) {
+        sprintf(msg, "not enough args in closure application -- "
+                "expected %s%ld, got %ld",
+                code_varargp(code) ? "at least " : "", nb_args, argc);
+        fatal_error(msg, sp);
+    }
+    if (argc > nb_args && !code_varargp(code)) {
+        sprintf(msg, "too many args in closure application -- "
+                "expected %ld, got %ld", nb_args, argc);
+        fatal_error(msg, sp);
+    }
+}
+
+// Pack the last nb_rest args, which are on the top of the stack from sp,
+// into a list.
+static obj_t *
+rest_list(obj_t **frame, obj_t **sp, long nb_rest)
+{
+    obj_t *rest = nil_wrap();
+    long i;
+
+    for (i = 0; i < nb_rest; ++i) {
+        rest = pair_wrap(frame, sp[i], rest);
+    }
+    return rest;
 }
 
+// Create the env for a closure application and bind the args on the
+// stack into its slots. The stack is [argn, ..., arg0, callable] from sp.
 static obj_t *
-apply_procedure(obj_t **frame)
+bind_arguments(obj_t **sp, obj_t *proc, long argc)
+{
+    obj_t *code = closure_body(proc);
+    obj_t *env;
+    obj_t **frame = sp;
+    long nb_args = code_nb_args(code);
+    long i;
+
+    env = environ_wrap_slots(frame, closure_env(proc), code_nb_slots(code));
+    for (i = 0; i < nb_args; ++i) {
+        environ_set_slot(env, i, sp[argc - 1 - i]);
+    }
+    if (code_varargp(code)) {
+        SGC_ROOT1(frame, env);
+        environ_set_slot(env, nb_args, rest_list(frame, sp, argc - nb_args));
+    }
+    return env;
+}
+
+// Bind the args on the stack into the slots below the frame, as a stack
+// env. The frame may overlap the args when it's reused by a tail call.
+static void
+bind_stack_slots(obj_t **frame, obj_t **sp, obj_t *proc, long argc)
 {
-    obj_t *proc;
-    obj_t **prev_frame = frame_prev(frame);
-    proc = prev_frame[-1];
-    return proc_unwrap(proc)(frame);
+    obj_t *code = closure_body(proc);
+    obj_t *vararg = NULL;
+    long nb_slots = code_nb_slots(code);
+    long nb_args = code_nb_args(code);
+    long i;
+
+    if (code_varargp(code)) {
+        vararg = rest_list(sp, sp, argc - nb_args);
+    }
+    // Slot i is at frame[-1 - i] and arg i at sp[argc - 1 - i]. The frame
+    // is never below the args, so an arg is always read before its place
+    // is written.
+    for (i = 0; i < nb_args; ++i) {
+        frame[-1 - i] = sp[argc - 1 - i];
+    }
+    if (vararg) {
+        frame[-1 - i++] = vararg;
+    }
+    for (; i < nb_slots; ++i) {
+        frame[-1 - i] = NULL;
+    }
+}
+
+// Skip the given number of lexical scopes.
+static obj_t *
+env_at_depth(obj_t **frame, long depth)
+{
+    obj_t *env = frame_env(frame);
+    for (; depth > 0; --depth) {
+        env = environ_outer(env);
+    }
+    return env;
 }
 
@@ -21,6 +21,7 @@ obj_t *frame_env(obj_t **frame);
 void frame_set_env(obj_t **frame, obj_t *new_env);
 obj_t **frame_ref(obj_t **frame, long index);
 
+// Evaluate the expression on frame_ref(frame, 0).
 obj_t *eval_frame(obj_t **frame);
 
 #endif /* SEVAL_H */
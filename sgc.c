@@ -2,6 +2,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "sgc.h"
 
 static bool_t gc_enabled = 1;
@@ -9,8 +14,16 @@ static bool_t gc_verbose = 0;
 static gc_visitor_t visitor_types[256];
 static gc_finalizer_t finalizer_types[256];
 
-// 8K pointers, 64KBytes of stack.
-static const size_t STACK_SIZE = 1024 * 8;
+// 64M pointers, 512MBytes of address space for the stack, of which only
+// the pages that get touched are backed by memory. A guard page below
+// catches what goes past it.
+static const size_t STACK_SIZE = 1024 * 1024 * 64;
+static size_t guard_size;
+
+// frame_extend leaves this many pointers below a new frame, which is
+// room for the pushes that don't go through it, e.g. the SGC_ROOT ones.
+#define STACK_HEADROOM (1024 * 64)
+obj_t **gc_stack_limit = NULL;
 
 // @see seval:new_frame() to see the frame layout.
 static obj_t **stack = NULL;
@@ -18,36 +31,185 @@ static obj_t **sp;
 
 // 2MBytes of heap.
 #define MIN_HEAP_SIZE (1024 * 1024 * 2)
-static obj_t *gc_head = NULL;
 static size_t next_collect = MIN_HEAP_SIZE;
 static const double expand_factor = 1.5;
 static size_t heap_size = 0;
 
+// Objects are born young and are promoted in place by surviving a
+// collection. A minor collection only marks and sweeps the objects
+// allocated since the last one, which happens each time the nursery
+// fills up. Once the heap reaches next_collect, a major collection
+// looks at everything.
+#define NURSERY_SIZE (1024 * 512)
+static size_t young_size = 0;
+static bool_t minor_collection = 0;
+
+// An object is marked when its gc_marked is mark_epoch, which flips
+// between 1 and 2 on each major collection. So the marks are never
+// cleared, and new objects are unmarked with 0.
+static bool_t mark_epoch = 1;
+#define is_marked(self) ((self)->gc_marked == mark_epoch)
+
+// With a pause budget, a major collection marks in slices of at most
+// that many microseconds, one each time MARK_SLICE_ALLOC bytes have been
+// allocated. Meanwhile new objects are allocated grey and the write
+// barrier greys what is stored into a marked object. The stack is
+// rescanned when the marking is done, right before the sweep.
+#define MARK_SLICE_ALLOC (1024 * 64)
+static long pause_budget = 0;
+bool_t gc_marking = 0;
+
+// The old objects that were made to point to young ones, which are
+// the roots of a minor collection besides the stack. @see gc_remember()
+static obj_t **remembered = NULL;
+static size_t nb_remembered = 0;
+static size_t remembered_alloc = 0;
+
+// Small objects are allocated from pages, each page holding slots of
+// one size class. Free slots are threaded through gc_next into per-class
+// free lists, and have ob_allocated cleared so that the sweep can walk
+// the pages linearly. The newest page of a class is bumped into, so its
+// slots past nb_used are not initialized yet. Larger objects are
+// malloc'ed and linked on gc_head.
+#define PAGE_SIZE (1024 * 64)
+#define SLOT_ALIGN 16
+#define MAX_SLOT_SIZE 256
+#define NB_SIZE_CLASSES (MAX_SLOT_SIZE / SLOT_ALIGN + 1)
+
+typedef struct page_t {
+    struct page_t *next;
+    size_t slot_size;
+    size_t nb_slots;
+    size_t nb_used;
+} page_t;
+
+#define PAGE_HEADER_SIZE \
+    ((sizeof(page_t) + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN)
+#define page_slot(page, i) \
+    ((obj_t *)((char *)(page) + PAGE_HEADER_SIZE + (i) * (page)->slot_size))
+
+static page_t *pages[NB_SIZE_CLASSES];
+static obj_t *free_lists[NB_SIZE_CLASSES];
+
+// A major collection leaves the pages to be swept by the allocator,
+// when it runs out of free slots in a size class. The pages after
+// *sweep_cursors[cls] are still to be swept, and the free lists are
+// rebuilt from them. Everything is swept before the next major marking.
+static page_t **sweep_cursors[NB_SIZE_CLASSES];
+// Bytes marked by the last major collection, which is what heap_size
+// becomes without waiting for the sweep.
+static size_t marked_size = 0;
+static obj_t *gc_head = NULL;
+// The young small objects, linked through gc_next.
+static obj_t *young_head = NULL;
+
+// Marked objects whose children are yet to be marked. When it can't
+// grow, the object is left marked and the heap is rescanned for them.
+// @see drain_grey_stack()
+#define GREY_STACK_INIT_SIZE 4096
+static obj_t **grey_stack = NULL;
+static size_t nb_grey = 0;
+static size_t grey_alloc = 0;
+static bool_t grey_overflow = 0;
+
+// A major collection drains the grey objects with several threads.
+// Each has a deque of grey objects, that it pushes to and pops from at
+// the bottom, and that the others steal from at the top when they run
+// out of work. The mark bits are then claimed atomically.
+// The threads are started by gc_set_nb_threads(), and wait on work_cond
+// between collections, until parallel_drain() starts a new mark round.
+#define MAX_GC_THREADS 64
+typedef struct {
+    pthread_mutex_t lock;
+    obj_t **items;
+    size_t top, bottom, nb_alloc;
+    size_t marked_size;
+    pthread_t thread;
+} mark_worker_t;
+
+static mark_worker_t workers[MAX_GC_THREADS];
+static int nb_gc_threads = 1;
+static int nb_active_workers = 0;
+static bool_t parallel_marking = 0;
+// The threads of workers[1..nb_gc_threads), and their mark rounds.
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static unsigned long mark_round = 0;
+static int nb_busy_workers = 0;
+static __thread mark_worker_t *current_worker = NULL;
+
+static void push_grey(obj_t *self);
+static void start_sweeping();
+static void finish_sweeping();
+static bool_t sweep_next_page(size_t cls);
+static void sweep_young();
+static void sweep_large_objects();
+static void walk_heap(void (*fn)(obj_t *, void *), void *arg);
+
 void
 sgc_init()
 {
     static bool_t initialized = 0;
+    int i;
     if (initialized)
         return;
 
     initialized = 1;
-    stack = (obj_t **)malloc(STACK_SIZE * sizeof(obj_t *));
-    memset(stack, 0, STACK_SIZE * sizeof(obj_t *));
+    for (i = 0; i < MAX_GC_THREADS; ++i) {
+        pthread_mutex_init(&workers[i].lock, NULL);
+    }
+    guard_size = sysconf(_SC_PAGESIZE);
+    stack = mmap(NULL, guard_size + STACK_SIZE * sizeof(obj_t *),
+                 PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (stack == MAP_FAILED)
+        fatal_error("sgc_init: can't map the stack", NULL);
+    mprotect(stack, guard_size, PROT_NONE);
+    stack = (obj_t **)((char *)stack + guard_size);
     sp = stack + STACK_SIZE;
+    gc_stack_limit = stack + STACK_HEADROOM;
 }
 
 void sgc_fini()
 {
     obj_t *victim, *self;
+    page_t *page, *next_page;
+    size_t cls, i;
+
+    for (cls = 0; cls < NB_SIZE_CLASSES; ++cls) {
+        for (page = pages[cls]; page; page = next_page) {
+            next_page = page->next;
+            for (i = 0; i < page->nb_used; ++i) {
+                self = page_slot(page, i);
+                if (self->ob_allocated)
+                    finalizer_types[get_type(self)](self);
+            }
+            free(page);
+        }
+        pages[cls] = NULL;
+        free_lists[cls] = NULL;
+    }
+
     self = gc_head;
     while (self) {
         victim = self;
         self = self->gc_next;
         finalizer_types[get_type(victim)](victim);
+        free(victim);
     }
     gc_head = NULL;
+    young_head = NULL;
 
-    free(stack);
+    gc_set_nb_threads(1);
+    free(remembered);
+    free(grey_stack);
+    for (i = 0; i < MAX_GC_THREADS; ++i) {
+        free(workers[i].items);
+        workers[i].items = NULL;
+    }
+    munmap((char *)stack - guard_size,
+           guard_size + STACK_SIZE * sizeof(obj_t *));
 }
 
 void
@@ -68,35 +230,104 @@ gc_set_verbose(bool_t p)
     gc_verbose = p;
 }
 
+// Start bumping into a new page of the size class.
+static bool_t
+add_page(size_t cls)
+{
+    page_t *page;
+
+    if (posix_memalign((void **)&page, PAGE_SIZE, PAGE_SIZE))
+        return 0;
+    page->slot_size = cls * SLOT_ALIGN;
+    page->nb_slots = (PAGE_SIZE - PAGE_HEADER_SIZE) / page->slot_size;
+    page->nb_used = 0;
+    page->next = pages[cls];
+    pages[cls] = page;
+    return 1;
+}
+
+static obj_t *
+alloc_slot(size_t cls)
+{
+    obj_t *res;
+    page_t *page;
+
+    while (!(res = free_lists[cls]) && sweep_next_page(cls)) {
+    }
+    if (res) {
+        free_lists[cls] = res->gc_next;
+        return res;
+    }
+    page = pages[cls];
+    if ((!page || page->nb_used == page->nb_slots)) {
+        if (!add_page(cls))
+            return NULL;
+        page = pages[cls];
+    }
+    return page_slot(page, page->nb_used++);
+}
+
 obj_t *
 gc_malloc(size_t size, type_t ob_type)
 {
     obj_t *res;
+    size_t cls;
 
     if (ob_type > TP_MAX) {
         // Invalid type
         fatal_error("gc_malloc: unknown type of object", NULL);
     }
 
+    // Checked before the allocation, so that it always succeeds
+    // right after a collection.
+    if (gc_want_collect()) {
+        return NULL;
+    }
+
     size += sizeof(header_obj_t);
-    if (heap_size + size > next_collect && gc_enabled) {
-        res = NULL;
+    if (size <= MAX_SLOT_SIZE) {
+        cls = (size + SLOT_ALIGN - 1) / SLOT_ALIGN;
+        if (!(res = alloc_slot(cls)))
+            return NULL;
+        size = cls * SLOT_ALIGN;
+        res->gc_next = young_head;
+        young_head = res;
     }
     else {
-        res = malloc(size);  // calloc will be better.
-        if (res) {
-            res->gc_next = gc_head;
-            res->gc_marked = 0;
-            res->ob_type = ob_type;
-            res->ob_size = size;
-
-            gc_head = res;
-            heap_size += size;
-        }
+        res = malloc(size);
+        if (!res)
+            return NULL;
+        res->gc_next = gc_head;
+        gc_head = res;
     }
+    res->gc_marked = 0;
+    if (gc_marking) {
+        res->gc_marked = mark_epoch;
+        marked_size += size;
+        push_grey(res);
+    }
+    res->ob_type = ob_type;
+    res->ob_allocated = OB_YOUNG;
+    res->ob_bar = 0;
+    res->ob_size = size;
+    heap_size += size;
+    young_size += size;
     return res;
 }
 
+void
+gc_remember(obj_t *self)
+{
+    if (nb_remembered == remembered_alloc) {
+        remembered_alloc = remembered_alloc ? remembered_alloc * 2 : 256;
+        remembered = realloc(remembered, remembered_alloc * sizeof(obj_t *));
+        if (!remembered)
+            fatal_error("gc_remember: out of memory", NULL);
+    }
+    self->ob_bar = 1;
+    remembered[nb_remembered++] = self;
+}
+
 void
 gc_register_type(type_t tp_index, gc_visitor_t v, gc_finalizer_t fini)
 {
@@ -104,25 +335,313 @@ gc_register_type(type_t tp_index, gc_visitor_t v, gc_finalizer_t fini)
     finalizer_types[tp_index] = fini;
 }
 
-size_t
+#define should_mark(self) \
+    ((self) && !immediatep(self) && !is_marked(self) && \
+     !(minor_collection && (self)->ob_allocated == OB_OLD))
+
+// Tell if the caller is the one that marked it.
+static bool_t
+claim_mark(obj_t *self)
+{
+    if (parallel_marking) {
+        if (__atomic_exchange_n(&self->gc_marked, mark_epoch,
+                                __ATOMIC_RELAXED) == mark_epoch)
+            return 0;
+        current_worker->marked_size += self->ob_size;
+        return 1;
+    }
+    self->gc_marked = mark_epoch;
+    marked_size += self->ob_size;
+    return 1;
+}
+
+static void
+deque_push(mark_worker_t *w, obj_t *self)
+{
+    obj_t **new_items;
+    size_t new_alloc;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->top == w->bottom) {
+        w->top = w->bottom = 0;
+    }
+    if (w->bottom == w->nb_alloc) {
+        new_alloc = w->nb_alloc ? w->nb_alloc * 2 : GREY_STACK_INIT_SIZE;
+        new_items = realloc(w->items, new_alloc * sizeof(obj_t *));
+        if (!new_items) {
+            __atomic_store_n(&grey_overflow, 1, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&w->lock);
+            return;
+        }
+        w->items = new_items;
+        w->nb_alloc = new_alloc;
+    }
+    w->items[w->bottom++] = self;
+    pthread_mutex_unlock(&w->lock);
+}
+
+static obj_t *
+deque_pop(mark_worker_t *w)
+{
+    obj_t *res = NULL;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->top != w->bottom)
+        res = w->items[--w->bottom];
+    pthread_mutex_unlock(&w->lock);
+    return res;
+}
+
+static obj_t *
+deque_steal(mark_worker_t *w)
+{
+    obj_t *res = NULL;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->top != w->bottom)
+        res = w->items[w->top++];
+    pthread_mutex_unlock(&w->lock);
+    return res;
+}
+
+static void
+push_grey(obj_t *self)
+{
+    obj_t **new_stack;
+    size_t new_alloc;
+
+    if (current_worker) {
+        deque_push(current_worker, self);
+        return;
+    }
+    if (nb_grey == grey_alloc) {
+        new_alloc = grey_alloc ? grey_alloc * 2 : GREY_STACK_INIT_SIZE;
+        new_stack = realloc(grey_stack, new_alloc * sizeof(obj_t *));
+        if (!new_stack) {
+            grey_overflow = 1;
+            return;
+        }
+        grey_stack = new_stack;
+        grey_alloc = new_alloc;
+    }
+    grey_stack[nb_grey++] = self;
+}
+
+void
 gc_mark(obj_t *self)
 {
-    size_t mark_count = 0;
-    while (self && !self->gc_marked) {
-        ++mark_count;
-        self->gc_marked = 1;
-        self = visitor_types[get_type(self)](self);
+    if (should_mark(self) && claim_mark(self)) {
+        push_grey(self);
+    }
+}
+
+void
+gc_mark_barrier(obj_t *self, obj_t *value)
+{
+    if (is_marked(self))
+        gc_mark(value);
+}
+
+// The visitor marks the children of an object but one, which is
+// followed here without going through the stack.
+static void
+visit_grey(obj_t *self)
+{
+    while ((self = visitor_types[get_type(self)](self)) &&
+            should_mark(self) && claim_mark(self)) {
+    }
+}
+
+static void
+drain_grey_stack()
+{
+    while (nb_grey) {
+        visit_grey(grey_stack[--nb_grey]);
+    }
+}
+
+static obj_t *
+steal_grey(mark_worker_t *self)
+{
+    obj_t *res;
+    int i;
+
+    for (i = 0; i < nb_gc_threads; ++i) {
+        if (&workers[i] != self && (res = deque_steal(&workers[i])))
+            return res;
+    }
+    return NULL;
+}
+
+// Go idle until there is something to steal, or until every worker is
+// idle, which means that the marking is done.
+static bool_t
+wait_for_work()
+{
+    int i;
+
+    __atomic_sub_fetch(&nb_active_workers, 1, __ATOMIC_SEQ_CST);
+    for (;;) {
+        if (__atomic_load_n(&nb_active_workers, __ATOMIC_SEQ_CST) == 0)
+            return 0;
+        for (i = 0; i < nb_gc_threads; ++i) {
+            if (__atomic_load_n(&workers[i].top, __ATOMIC_RELAXED) !=
+                    __atomic_load_n(&workers[i].bottom, __ATOMIC_RELAXED)) {
+                __atomic_add_fetch(&nb_active_workers, 1, __ATOMIC_SEQ_CST);
+                return 1;
+            }
+        }
+        sched_yield();
+    }
+}
+
+static void
+mark_worker(mark_worker_t *self)
+{
+    obj_t *grey;
+
+    current_worker = self;
+    do {
+        while ((grey = deque_pop(self)) || (grey = steal_grey(self))) {
+            visit_grey(grey);
+        }
+    } while (wait_for_work());
+    current_worker = NULL;
+}
+
+// The thread of a worker other than the first: it marks once per round,
+// until nb_gc_threads no longer covers it.
+static void *
+pool_worker(void *arg)
+{
+    mark_worker_t *self = arg;
+    unsigned long round;
+
+    pthread_mutex_lock(&pool_lock);
+    round = mark_round;
+    for (;;) {
+        while (round == mark_round && self - workers < nb_gc_threads)
+            pthread_cond_wait(&work_cond, &pool_lock);
+        if (self - workers >= nb_gc_threads)
+            break;
+        round = mark_round;
+        pthread_mutex_unlock(&pool_lock);
+        mark_worker(self);
+        pthread_mutex_lock(&pool_lock);
+        if (--nb_busy_workers == 0)
+            pthread_cond_signal(&done_cond);
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return NULL;
+}
+
+// Share the grey stack among the workers and let them drain it. The
+// collecting thread is the first worker.
+static void
+parallel_drain()
+{
+    size_t i;
+    int n = nb_gc_threads;
+
+    for (i = 0; i < nb_grey; ++i) {
+        deque_push(&workers[i % n], grey_stack[i]);
+    }
+    nb_grey = 0;
+
+    parallel_marking = 1;
+    nb_active_workers = n;
+    for (i = 0; i < n; ++i) {
+        workers[i].marked_size = 0;
+    }
+    pthread_mutex_lock(&pool_lock);
+    nb_busy_workers = n - 1;
+    ++mark_round;
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&pool_lock);
+
+    mark_worker(&workers[0]);
+
+    // The others may still be leaving their loop.
+    pthread_mutex_lock(&pool_lock);
+    while (nb_busy_workers)
+        pthread_cond_wait(&done_cond, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+    parallel_marking = 0;
+    for (i = 0; i < n; ++i) {
+        marked_size += workers[i].marked_size;
+    }
+}
+
+static long
+usec_since(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000 +
+           (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+// Drain the grey stack within the pause budget, and tell if it's done.
+static bool_t
+mark_slice()
+{
+    struct timespec start;
+    size_t nb_visited = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (nb_grey) {
+        visit_grey(grey_stack[--nb_grey]);
+        if (++nb_visited % 256 == 0 && usec_since(&start) >= pause_budget)
+            return 0;
+    }
+    return 1;
+}
+
+static void
+revisit_marked(obj_t *self, void *arg)
+{
+    if (is_marked(self))
+        gc_mark(visitor_types[get_type(self)](self));
+}
+
+static void
+finish_marking()
+{
+    void (*drain)() = drain_grey_stack;
+
+    // Not worth the threads for a minor collection.
+    if (!minor_collection && nb_gc_threads > 1)
+        drain = parallel_drain;
+
+    drain();
+    while (grey_overflow) {
+        // Some marked objects may not have been visited.
+        grey_overflow = 0;
+        walk_heap(revisit_marked, NULL);
+        drain();
+    }
+}
+
+static void
+mark_stack(obj_t **frame_ptr)
+{
+    obj_t **iter;
+
+    // Everything on the stack is an object, an immediate, NULL or a
+    // tagged frame pointer. @see seval:frame_extend()
+    for (iter = frame_ptr; iter < stack + STACK_SIZE; ++iter) {
+        if (!sgc_framep(*iter))
+            gc_mark(*iter);
     }
-    return mark_count;
 }
 
 size_t
 gc_collect(obj_t **frame_ptr)
 {
-    obj_t **iter;
-    obj_t *self, *victim;
+    obj_t *self;
     size_t size_pre_gc = heap_size;
     size_t bytes_freed;
+    size_t i;
 
     if (!gc_enabled) {
         // Debug
@@ -132,59 +651,70 @@ gc_collect(obj_t **frame_ptr)
         return 0;
     }
 
+    if (gc_marking) {
+        young_size = 0;
+        // Don't let the heap run away from an incremental collection.
+        if (!mark_slice() && heap_size < 2 * next_collect)
+            return 0;
+        gc_marking = 0;
+        size_pre_gc = heap_size;
+    }
+    else {
+        minor_collection = heap_size + NURSERY_SIZE <= next_collect;
+        if (!minor_collection) {
+            // The unswept objects would look marked after two flips.
+            finish_sweeping();
+            mark_epoch = 3 - mark_epoch;
+            marked_size = 0;
+            if (pause_budget) {
+                gc_marking = 1;
+                young_size = 0;
+                mark_stack(frame_ptr);
+                return 0;
+            }
+        }
+    }
+
     // Debug
     if (gc_verbose)
-        fprintf(stderr, "; heap (%ld/%ld), gc collecting...\n",
-                heap_size, next_collect);
+        fprintf(stderr, "; heap (%ld/%ld), %s collecting...\n",
+                heap_size, next_collect, minor_collection ? "minor" : "major");
 
     // Firstly mark the stack
-    for (iter = frame_ptr; iter < stack + STACK_SIZE; ++iter) {
-        // XXX: be aware of the frame pointer:
-        // If *iter is in the stack, then just ignore it.
-        // @see seval:new_frame()
-        if ((obj_t **)*iter > iter && (obj_t **)*iter < stack + STACK_SIZE)
-            continue;
-        gc_mark(*iter);
-    }
-
-    // Then sweep. Don't look at the head now.
-    if (gc_head) {
-        self = gc_head;
-        // XXX: Be careful when writing singly-linked-list...
-        while (self->gc_next) {
-            victim = self->gc_next;
-            if (!victim->gc_marked) {
-                self->gc_next = victim->gc_next;
-                heap_size -= victim->ob_size;
-                finalizer_types[get_type(victim)](victim);
-            }
-            else {
-                self = self->gc_next;
-            }
-        }
+    mark_stack(frame_ptr);
 
-        // Sweep the head.
-        victim = gc_head;
-        if (!victim->gc_marked) {
-            gc_head = victim->gc_next;
-            heap_size -= victim->ob_size;
-            finalizer_types[get_type(victim)](victim);
-        }
+    // The young objects that the old ones point to.
+    for (i = 0; i < nb_remembered; ++i) {
+        self = remembered[i];
+        if (minor_collection)
+            gc_mark(visitor_types[get_type(self)](self));
+        self->ob_bar = 0;
     }
+    nb_remembered = 0;
+    finish_marking();
 
-    // Clean marks
-    for (self = gc_head; self; self = self->gc_next) {
-        // Must be all marked
-        self->gc_marked = 0;
-    }
+    // Then sweep the young objects, which also promotes the survivors.
+    // No old object points to a young one after that. The old objects
+    // in pages are swept lazily after a major collection.
+    sweep_young();
+    sweep_large_objects();
+    young_size = 0;
 
+    if (!minor_collection) {
+        start_sweeping();
+        heap_size = marked_size;
+    }
     bytes_freed = size_pre_gc - heap_size;
 
-    // Record the current size to determine the heap threshold for next gc.
-    next_collect = heap_size * expand_factor;
-    if (next_collect < MIN_HEAP_SIZE) {
-        next_collect = MIN_HEAP_SIZE;
+    if (!minor_collection) {
+        // Record the current size to determine the heap threshold
+        // for next major gc.
+        next_collect = heap_size * expand_factor;
+        if (next_collect < MIN_HEAP_SIZE) {
+            next_collect = MIN_HEAP_SIZE;
+        }
     }
+    minor_collection = 0;
 
     // Debug
     if (gc_verbose)
@@ -194,10 +724,229 @@ gc_collect(obj_t **frame_ptr)
     return bytes_freed;
 }
 
+// Merge sort the pages by address.
+static page_t *
+sort_pages(page_t *list)
+{
+    page_t *half, *iter, *res, **tail;
+
+    if (!list || !list->next)
+        return list;
+    half = list;
+    for (iter = list->next; iter && iter->next; iter = iter->next->next) {
+        half = half->next;
+    }
+    iter = half->next;
+    half->next = NULL;
+    list = sort_pages(list);
+    iter = sort_pages(iter);
+
+    tail = &res;
+    while (list && iter) {
+        if (list < iter) {
+            *tail = list;
+            list = list->next;
+        }
+        else {
+            *tail = iter;
+            iter = iter->next;
+        }
+        tail = &(*tail)->next;
+    }
+    *tail = list ? list : iter;
+    return res;
+}
+
+// Objects can't be moved, since the C code keeps pointers to them. So
+// the pages are swept, and then allocated from, in address order. New
+// objects are packed at the low end of the heap, and the pages at the
+// high end get the chance to empty out and be given back.
+static void
+start_sweeping()
+{
+    size_t cls;
+
+    // The free slots are found again by the sweep.
+    for (cls = 0; cls < NB_SIZE_CLASSES; ++cls) {
+        free_lists[cls] = NULL;
+        pages[cls] = sort_pages(pages[cls]);
+        sweep_cursors[cls] = &pages[cls];
+    }
+}
+
+// Free the dead old objects of the next unswept page of the size class,
+// or give back the page if nothing is left in it. The young objects are
+// those allocated since the major collection, and are kept.
+static bool_t
+sweep_next_page(size_t cls)
+{
+    page_t *page, **link = sweep_cursors[cls];
+    obj_t *self, *saved_free_list = free_lists[cls];
+    size_t i, nb_kept = 0;
+
+    if (!link || !(page = *link))
+        return 0;
+
+    // The page may not be the newest one anymore, so its unused slots
+    // go to the free list too.
+    for (i = page->nb_used; i < page->nb_slots; ++i) {
+        page_slot(page, i)->ob_allocated = OB_FREE;
+    }
+    page->nb_used = page->nb_slots;
+
+    // In reverse, so that the slots are handed out in address order.
+    for (i = page->nb_slots; i-- > 0; ) {
+        self = page_slot(page, i);
+        if (self->ob_allocated == OB_YOUNG ||
+                (self->ob_allocated == OB_OLD && is_marked(self))) {
+            ++nb_kept;
+            continue;
+        }
+        if (self->ob_allocated == OB_OLD) {
+            finalizer_types[get_type(self)](self);
+            self->ob_allocated = OB_FREE;
+        }
+        self->gc_next = free_lists[cls];
+        free_lists[cls] = self;
+    }
+    if (nb_kept == 0) {
+        free_lists[cls] = saved_free_list;
+        *link = page->next;
+        free(page);
+    }
+    else {
+        sweep_cursors[cls] = &page->next;
+    }
+    return 1;
+}
+
+static void
+finish_sweeping()
+{
+    size_t cls;
+
+    for (cls = 0; cls < NB_SIZE_CLASSES; ++cls) {
+        while (sweep_next_page(cls)) {
+        }
+    }
+}
+
+// Only walk the objects allocated since the last collection.
+static void
+sweep_young()
+{
+    obj_t *self, *next;
+    size_t cls;
+
+    for (self = young_head; self; self = next) {
+        next = self->gc_next;
+        self->gc_next = NULL;
+        if (is_marked(self)) {
+            self->ob_allocated = OB_OLD;
+        }
+        else {
+            finalizer_types[get_type(self)](self);
+            heap_size -= self->ob_size;
+            self->ob_allocated = OB_FREE;
+            cls = self->ob_size / SLOT_ALIGN;
+            self->gc_next = free_lists[cls];
+            free_lists[cls] = self;
+        }
+    }
+    young_head = NULL;
+}
+
+static void
+sweep_large_objects()
+{
+    obj_t *self, **link;
+
+    link = &gc_head;
+    while ((self = *link)) {
+        if (minor_collection && self->ob_allocated == OB_OLD) {
+            link = &self->gc_next;
+        }
+        else if (is_marked(self)) {
+            self->ob_allocated = OB_OLD;
+            link = &self->gc_next;
+        }
+        else {
+            *link = self->gc_next;
+            heap_size -= self->ob_size;
+            finalizer_types[get_type(self)](self);
+            free(self);
+        }
+    }
+}
+
+// Call fn on every allocated object.
+static void
+walk_heap(void (*fn)(obj_t *, void *), void *arg)
+{
+    page_t *page;
+    obj_t *self;
+    size_t cls, i;
+
+    for (cls = 0; cls < NB_SIZE_CLASSES; ++cls) {
+        for (page = pages[cls]; page; page = page->next) {
+            for (i = 0; i < page->nb_used; ++i) {
+                self = page_slot(page, i);
+                if (self->ob_allocated)
+                    fn(self, arg);
+            }
+        }
+    }
+    for (self = gc_head; self; self = self->gc_next) {
+        fn(self, arg);
+    }
+}
+
 bool_t
 gc_want_collect()
 {
-    return heap_size > next_collect && gc_enabled;
+    if (!gc_enabled)
+        return 0;
+    if (gc_marking)
+        return young_size >= MARK_SLICE_ALLOC;
+    return young_size >= NURSERY_SIZE || heap_size >= next_collect;
+}
+
+void
+gc_set_pause_budget(long usec)
+{
+    pause_budget = usec;
+}
+
+void
+gc_set_nb_threads(int n)
+{
+    int old, i;
+
+    if (n < 1)
+        n = 1;
+    if (n > MAX_GC_THREADS)
+        n = MAX_GC_THREADS;
+
+    pthread_mutex_lock(&pool_lock);
+    old = nb_gc_threads;
+    nb_gc_threads = n;
+    // Those which are no longer covered leave.
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&pool_lock);
+    for (i = n; i < old; ++i) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    // Marking goes on with the threads which could be started.
+    pthread_mutex_lock(&pool_lock);
+    for (i = old; i < n; ++i) {
+        if (pthread_create(&workers[i].thread, NULL, pool_worker,
+                           &workers[i])) {
+            nb_gc_threads = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
 }
 
 obj_t **
@@ -218,17 +967,21 @@ gc_incr_stack_base(long nb_incr)
     sp += nb_incr;
 }
 
+static void
+print_heap_object(obj_t *self, void *arg)
+{
+    long *i = arg;
+    fprintf(stderr, "#%3ld  %p  ", (*i)++, self);
+    print_repr(self, stderr);
+    fprintf(stderr, "\n");
+}
+
 void
 gc_print_heap()
 {
-    obj_t *iter;
     long i = 0;
     fprintf(stderr, "\nGC-PRINT-HEAP\n=============\n\n");
-    for (iter = gc_head; iter; iter = iter->gc_next) {
-        fprintf(stderr, "#%3ld  %p  ", i++, iter);
-        print_repr(iter, stderr);
-        fprintf(stderr, "\n");
-    }
+    walk_heap(print_heap_object, &i);
     fprintf(stderr, "\n");
     fprintf(stderr, "\n*************\nGC-PRINT-HEAP\n\n");
 }
@@ -251,8 +1004,7 @@ gc_stack_trace_lite(obj_t **frame)
 
     // Then print out the variables
     for (iter = frame; iter < end; ++iter) {
-        if ((obj_t **)*iter > iter &&
-                (obj_t **)*iter < stack + STACK_SIZE) {
+        if (sgc_framep(*iter)) {
             //fprintf(stderr, "[frame-ptr]");
             ++depth;
         }
@@ -273,9 +1025,9 @@ gc_print_stack(obj_t **frame)
     long i = 0;
     fprintf(stderr, "\nGC-PRINT-STACK\n==============\n\n");
     for (iter = frame; iter < stack + STACK_SIZE; ++iter) {
-        // If *iter is in the stack, then just ignore it.
-        if ((obj_t **)*iter > iter && (obj_t **)*iter < stack + STACK_SIZE) {
-            fprintf(stderr, "#%3ld  %p  [frame-pointer-dump]\n", i++, *iter);
+        if (sgc_framep(*iter)) {
+            fprintf(stderr, "#%3ld  %p  [frame-pointer-dump]\n", i++,
+                    SGC_UNTAG_FRAME(*iter));
         }
         else if (!*iter) {
             fprintf(stderr, "#%3ld  %p\n", i++, *iter);
@@ -289,37 +1041,50 @@ gc_print_stack(obj_t **frame)
     fprintf(stderr, "\n**************\nGC-PRINT-STACK\n\n");
 }
 
-obj_t *
-gc_find_backptr_of(obj_t *o, long nth)
+struct backptr_search {
+    obj_t *target;
+    long nth;
+    long count;
+    obj_t *found;
+};
+
+static bool_t
+contains_ptr(obj_t *self, obj_t *o)
 {
-    long count = 0;
-    obj_t *iter;
-    for (iter = gc_head; iter; iter = iter->gc_next) {
-        switch (get_type(iter)) {
-            case TP_PAIR:
-                if (pair_car(iter) == o)
-                    goto found;
-                if (pair_cdr(iter) == o)
-                    goto found;
-                break;
-
-            case TP_VECTOR:
-                {
-                    size_t i = 0, len = vector_length(iter);
-                    for (; i < len; ++i) {
-                        if (*vector_ref(iter, i) == o)
-                            goto found;
-                    }
-                }
-                break;
+    size_t i, len;
+
+    switch (get_type(self)) {
+    case TP_PAIR:
+        return pair_car(self) == o || pair_cdr(self) == o;
+
+    case TP_VECTOR:
+        for (i = 0, len = vector_length(self); i < len; ++i) {
+            if (*vector_ref(self, i) == o)
+                return 1;
         }
-        continue;
-found:
-        if (count >= nth)
-            return iter;
-        else
-            ++count;
+        return 0;
+
+    default:
+        return 0;
     }
-    return NULL;
 }
 
+static void
+search_backptr(obj_t *self, void *arg)
+{
+    struct backptr_search *search = arg;
+    if (search->found || !contains_ptr(self, search->target))
+        return;
+    if (search->count >= search->nth)
+        search->found = self;
+    else
+        ++search->count;
+}
+
+obj_t *
+gc_find_backptr_of(obj_t *o, long nth)
+{
+    struct backptr_search search = { o, nth, 0, NULL };
+    walk_heap(search_backptr, &search);
+    return search.found;
+}
@@ -31,6 +31,42 @@
             *frame_ptr = o3; \
         } while (0)
 
+// The generation of an object, kept in its ob_allocated.
+#define OB_FREE 0
+#define OB_YOUNG 1
+#define OB_OLD 2
+
+// Should be used after storing value into an object that may be old,
+// which is anything that may have survived a collection since its
+// creation. The ob_bar tells that it's already remembered. While an
+// incremental collection is marking, the value also gets marked if the
+// object already is.
+#define SGC_WRITE_BARRIER(self, value) \
+    do { \
+        if ((value) && !immediatep(value)) { \
+            if ((self)->ob_allocated == OB_OLD && !(self)->ob_bar && \
+                    (value)->ob_allocated == OB_YOUNG) \
+                gc_remember(self); \
+            if (gc_marking) \
+                gc_mark_barrier(self, value); \
+        } \
+    } while (0)
+
+extern bool_t gc_marking;
+
+// A saved frame pointer on the stack is tagged, so that the collector
+// knows it precisely from the objects around it. Objects are at least
+// 16-byte aligned and immediates use the lowest two bits.
+#define SGC_FRAME_TAG 4
+#define SGC_TAG_FRAME(frame) ((obj_t *)((uintptr_t)(frame) | SGC_FRAME_TAG))
+#define SGC_UNTAG_FRAME(o) ((obj_t **)((uintptr_t)(o) & ~(uintptr_t)7))
+#define sgc_framep(o) (((uintptr_t)(o) & 7) == SGC_FRAME_TAG)
+
+// Whether the stack would overflow by extending it down to ptr.
+#define SGC_STACK_OVERFLOWP(ptr) ((ptr) < gc_stack_limit)
+
+extern obj_t **gc_stack_limit;
+
 typedef obj_t * (*gc_visitor_t) (obj_t *);
 typedef void (*gc_finalizer_t) (obj_t *);
 
@@ -43,9 +79,18 @@ void gc_set_verbose(bool_t);
 
 obj_t *gc_malloc(size_t size, type_t ob_type);
 void gc_register_type(type_t tp_index, gc_visitor_t v, gc_finalizer_t fini);
-size_t gc_mark(obj_t *self);
+// Used by the visitors, the object is marked and its children are
+// visited later.
+void gc_mark(obj_t *self);
 size_t gc_collect(obj_t **frame_ptr);
 bool_t gc_want_collect();
+void gc_remember(obj_t *self);
+void gc_mark_barrier(obj_t *self, obj_t *value);
+// Microseconds of marking per slice, or 0 to collect all at once.
+void gc_set_pause_budget(long usec);
+// Threads that mark during a major collection, which are started here
+// and kept waiting between collections.
+void gc_set_nb_threads(int n);
 
 obj_t **gc_get_stack_base();
 void gc_set_stack_base(obj_t **new_sp);
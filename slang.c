@@ -9,19 +9,28 @@ typedef struct {
     sobj_funcptr2_t call;
 } langdef_t;
 
-static header_obj_t _tail_token;
-static obj_t *tail_token = (obj_t *)&_tail_token;
-
-static obj_t *lang_if(obj_t **frame, obj_t **tailp);
-static obj_t *lang_lambda(obj_t **frame, obj_t **tailp);
-static obj_t *lang_define(obj_t **frame, obj_t **tailp);
-static obj_t *lang_set(obj_t **frame, obj_t **tailp);
-static obj_t *lang_begin(obj_t **frame, obj_t **tailp);
-static obj_t *lang_quote(obj_t **frame, obj_t **tailp);
-static obj_t *lang_quasiquote(obj_t **frame, obj_t **tailp);  // Not nested
+// Each language def analyses the (cdr of the) form on frame_ref(frame, 0)
+// under the given scope, and returns the resulting node.
+static obj_t *lang_if(obj_t **frame, obj_t *scope);
+static obj_t *lang_lambda(obj_t **frame, obj_t *scope);
+static obj_t *lang_define(obj_t **frame, obj_t *scope);
+static obj_t *lang_set(obj_t **frame, obj_t *scope);
+static obj_t *lang_begin(obj_t **frame, obj_t *scope);
+static obj_t *lang_quote(obj_t **frame, obj_t *scope);
+static obj_t *lang_quasiquote(obj_t **frame, obj_t *scope);
+static obj_t *lang_let(obj_t **frame, obj_t *scope);
+static obj_t *lang_let_star(obj_t **frame, obj_t *scope);
+static obj_t *lang_letrec(obj_t **frame, obj_t *scope);
+static obj_t *lang_do(obj_t **frame, obj_t *scope);
+static obj_t *lang_cond(obj_t **frame, obj_t *scope);
+static obj_t *lang_case(obj_t **frame, obj_t *scope);
+static obj_t *lang_and(obj_t **frame, obj_t *scope);
+static obj_t *lang_or(obj_t **frame, obj_t *scope);
+static obj_t *lang_when(obj_t **frame, obj_t *scope);
+static obj_t *lang_unless(obj_t **frame, obj_t *scope);
 
 // LOL... anyway, it's usable
-static obj_t *lang_lambda_syntax(obj_t **frame, obj_t **tailp);
+static obj_t *lang_lambda_syntax(obj_t **frame, obj_t *scope);
 
 static langdef_t specforms[] = {
     {"if", lang_if},
@@ -31,6 +40,16 @@ static langdef_t specforms[] = {
     {"begin", lang_begin},
     {"quote", lang_quote},
     {"quasiquote", lang_quasiquote},
+    {"let", lang_let},
+    {"let*", lang_let_star},
+    {"letrec", lang_letrec},
+    {"do", lang_do},
+    {"cond", lang_cond},
+    {"case", lang_case},
+    {"and", lang_and},
+    {"or", lang_or},
+    {"when", lang_when},
+    {"unless", lang_unless},
     {"lambda-syntax", lang_lambda_syntax},
 
     {NULL, NULL}
@@ -39,6 +58,21 @@ static langdef_t specforms[] = {
 static obj_t *symbol_quasiquote = NULL;
 static obj_t *symbol_unquote = NULL;
 static obj_t *symbol_unquote_splicing = NULL;
+static obj_t *symbol_let = NULL;
+static obj_t *symbol_let_star = NULL;
+static obj_t *symbol_letrec = NULL;
+static obj_t *symbol_do = NULL;
+static obj_t *symbol_if = NULL;
+static obj_t *symbol_begin = NULL;
+static obj_t *symbol_define = NULL;
+static obj_t *symbol_cond = NULL;
+static obj_t *symbol_else = NULL;
+static obj_t *symbol_arrow = NULL;
+
+static obj_t *analyze_symbol(obj_t **frame, obj_t *scope);
+static obj_t *analyze_call(obj_t **frame, obj_t *scope);
+static obj_t *analyze_body(obj_t **frame, obj_t *scope);
+static obj_t *analyze_sub(obj_t **frame, obj_t *expr, obj_t *scope);
 
 void
 slang_open(obj_t *env)
@@ -59,292 +93,1500 @@ slang_open(obj_t *env)
     symbol_quasiquote = symbol_intern(NULL, "quasiquote");
     symbol_unquote = symbol_intern(NULL, "unquote");
     symbol_unquote_splicing = symbol_intern(NULL, "unquote-splicing");
+    symbol_let = symbol_intern(NULL, "let");
+    symbol_let_star = symbol_intern(NULL, "let*");
+    symbol_letrec = symbol_intern(NULL, "letrec");
+    symbol_do = symbol_intern(NULL, "do");
+    symbol_if = symbol_intern(NULL, "if");
+    symbol_begin = symbol_intern(NULL, "begin");
+    symbol_define = symbol_intern(NULL, "define");
+    symbol_cond = symbol_intern(NULL, "cond");
+    symbol_else = symbol_intern(NULL, "else");
+    symbol_arrow = symbol_intern(NULL, "=>");
     gc_set_enabled(1);
 }
 
+// Scope handling.
+// A scope is either nil (toplevel) or the ND_LAMBDA node whose body is
+// being analysed. Names bound in a scope are its formals plus every
+// define seen in its body, and a lambda body is always analysed after
+// the body of its parent, so only the innermost scope may still grow.
+// References which can't be resolved to it yet are kept on the pending
+// list and fixed up by slang_analyze_lambda() once the body is done.
+// Each name has a slot in the env of the lambda's application, numbered
+// in the order of binding. The names list is kept in reverse order, so
+// that the slot of a name doesn't change when the scope grows.
+// The binding forms inside a lambda make block scopes, which are also
+// ND_LAMBDA nodes, flagged with LAMBDA_BLOCK. Their names are (name . slot)
+// pairs: the slots are taken in the env of the enclosing lambda, which
+// hosts the block, so no env is made for a block.
+// A block binds its names once per entry of the host, though: when the
+// host's env is captured, the binding forms are analysed again as the
+// application of lambdas, so that a closure or a continuation taken in
+// a form keeps the bindings of its own entry.
+
+#define LAMBDA_FORMALS  0
+#define LAMBDA_BODY     1
+#define LAMBDA_PARENT   2
+#define LAMBDA_NAMES    3
+#define LAMBDA_PENDING  4
+#define LAMBDA_SOURCE   5
+#define LAMBDA_MACROS   6  // (binding . macro) used to expand the body
+#define LAMBDA_CODE     7
+#define LAMBDA_CALLS    8  // global names called in the body
+#define NB_LAMBDA_KIDS  9
+
+// Flags in the ival of ND_LAMBDA nodes.
+#define LAMBDA_ANALYZED 1
+// Has inner lambdas, which capture its env, or assigns its variables.
+// Either way the env is shared, and can't be copied by call/cc.
+#define LAMBDA_CAPTURED 2
+#define LAMBDA_BLOCK    4
+// Has binding forms made into blocks.
+#define LAMBDA_LET_BLOCKS 8
+// Makes its binding forms into lambdas, @see let_envp().
+#define LAMBDA_LET_ENVS 16
+
+static bool_t
+scope_blockp(obj_t *scope)
+{
+    return (node_ival(scope) & LAMBDA_BLOCK) != 0;
+}
+
+// The lambda whose env holds the names of the scope.
+static obj_t *
+scope_host(obj_t *scope)
+{
+    while (scope_blockp(scope)) {
+        scope = node_ref(scope, LAMBDA_PARENT);
+    }
+    return scope;
+}
+
+// Returns the slot of the name, or -1 if it's not bound in the scope.
+static long
+scope_slot(obj_t *scope, obj_t *name)
+{
+    obj_t *iter;
+    long pos = 0;
+    long found = -1;
+    if (scope_blockp(scope)) {
+        for (iter = node_ref(scope, LAMBDA_NAMES); pairp(iter);
+                iter = pair_cdr(iter)) {
+            if (pair_caar(iter) == name)
+                return fixnum_unwrap(pair_cdr(pair_car(iter)));
+        }
+        return -1;
+    }
+    for (iter = node_ref(scope, LAMBDA_NAMES); pairp(iter);
+            iter = pair_cdr(iter), ++pos) {
+        if (found < 0 && pair_car(iter) == name)
+            found = pos;
+    }
+    return found < 0 ? -1 : pos - 1 - found;
+}
+
+static bool_t
+scope_has_name(obj_t *scope, obj_t *name)
+{
+    return scope_slot(scope, name) >= 0;
+}
+
+static void
+scope_add_name(obj_t **frame, obj_t *scope, obj_t *name)
+{
+    obj_t *names, *host, *entry;
+    if (nullp(scope) || scope_has_name(scope, name))
+        return;
+
+    SGC_ROOT2(frame, scope, name);
+    if (scope_blockp(scope)) {
+        // Take a new slot in the host, under no name.
+        host = scope_host(scope);
+        names = pair_wrap(frame, nil_wrap(), node_ref(host, LAMBDA_NAMES));
+        node_set(host, LAMBDA_NAMES, names);
+        entry = fixnum_wrap(frame, slang_lambda_nb_slots(host) - 1);
+        entry = pair_wrap(frame, name, entry);
+        names = pair_wrap(frame, entry, node_ref(scope, LAMBDA_NAMES));
+    }
+    else {
+        names = pair_wrap(frame, name, node_ref(scope, LAMBDA_NAMES));
+    }
+    node_set(scope, LAMBDA_NAMES, names);
+}
+
+static void
+scope_add_formals(obj_t **frame, obj_t *lambda)
+{
+    obj_t *iter;
+
+    for (iter = node_ref(lambda, LAMBDA_FORMALS); pairp(iter);
+            iter = pair_cdr(iter)) {
+        if (!symbolp(pair_car(iter))) {
+            fatal_error("lambda -- formals should be symbols", frame);
+        }
+        scope_add_name(frame, lambda, pair_car(iter));
+    }
+    if (symbolp(iter)) {
+        scope_add_name(frame, lambda, iter);
+    }
+    else if (!nullp(iter)) {
+        fatal_error("lambda -- malformed formals", frame);
+    }
+}
+
+// Returns the depth of the env which binds the name, or -1 if the name
+// is not lexically bound. *nb_levels is set to the number of envs, and
+// *slot to the slot of the name in the binding env.
+static long
+scope_resolve(obj_t *scope, obj_t *name, long *nb_levels, long *slot)
+{
+    long depth = 0;
+    long found = -1;
+    for (; !nullp(scope); scope = node_ref(scope, LAMBDA_PARENT)) {
+        if (found < 0 && (*slot = scope_slot(scope, name)) >= 0)
+            found = depth;
+        if (!scope_blockp(scope))
+            ++depth;
+    }
+    *nb_levels = depth;
+    return found;
+}
+
+// Decide whether a variable node (ND_?REF or ND_?SET) is a local or
+// global access.
+static void
+resolve_variable(obj_t **frame, obj_t *node, obj_t *scope, bool_t is_set)
+{
+    long nb_levels, slot;
+    long depth = scope_resolve(scope, node_ref(node, 0), &nb_levels, &slot);
+
+    if (depth < 0) {
+        node_set_kind(node, is_set ? ND_GSET : ND_GREF);
+        node_set_ival(node, nb_levels);
+    }
+    else {
+        node_set_kind(node, is_set ? ND_LSET : ND_LREF);
+        node_set_ival(node, depth);
+        node_set_slot(node, slot);
+        if (is_set && depth == 0) {
+            scope = scope_host(scope);
+            node_set_ival(scope, node_ival(scope) | LAMBDA_CAPTURED);
+        }
+    }
+
+    if (depth != 0 && !nullp(scope)) {
+        // The innermost lambda may define it later.
+        obj_t *pending;
+        scope = scope_host(scope);
+        SGC_ROOT2(frame, scope, node);
+        pending = pair_wrap(frame, node, node_ref(scope, LAMBDA_PENDING));
+        node_set(scope, LAMBDA_PENDING, pending);
+    }
+}
+
+static bool_t
+is_lexically_bound(obj_t *scope, obj_t *name)
+{
+    long nb_levels, slot;
+    return scope_resolve(scope, name, &nb_levels, &slot) >= 0;
+}
+
+// Macro expansions.
+// Lambda bodies remember the macro bindings they were expanded with, and
+// the global names they call, which are analysed as procedure calls.
+// When a macro binding is overwritten or a macro is bound, the epoch is
+// bumped and the code compiled before that gets checked on its next
+// application. @see slang_lambda_stalep()
+
+long slang_macro_epoch = 0;
+
+void
+slang_note_rebind(obj_t *old_value, obj_t *new_value)
+{
+    if ((old_value && macrop(old_value)) || macrop(new_value)) {
+        ++slang_macro_epoch;
+    }
+}
+
+static void
+add_macro_dependency(obj_t **frame, obj_t *lambda, obj_t *binding)
+{
+    obj_t *iter, *dep;
+
+    for (iter = node_ref(lambda, LAMBDA_MACROS); pairp(iter);
+            iter = pair_cdr(iter)) {
+        if (pair_caar(iter) == binding)
+            return;
+    }
+    SGC_ROOT2(frame, lambda, binding);
+    dep = pair_wrap(frame, binding, pair_cdr(binding));
+    dep = pair_wrap(frame, dep, node_ref(lambda, LAMBDA_MACROS));
+    node_set(lambda, LAMBDA_MACROS, dep);
+}
+
+static void
+add_call_dependency(obj_t **frame, obj_t *lambda, obj_t *name)
+{
+    obj_t *iter, *calls;
+
+    for (iter = node_ref(lambda, LAMBDA_CALLS); pairp(iter);
+            iter = pair_cdr(iter)) {
+        if (pair_car(iter) == name)
+            return;
+    }
+    SGC_ROOT2(frame, lambda, name);
+    calls = pair_wrap(frame, name, node_ref(lambda, LAMBDA_CALLS));
+    node_set(lambda, LAMBDA_CALLS, calls);
+}
+
 bool_t
-slang_tailp(obj_t *val)
+slang_lambda_stalep(obj_t *env, obj_t *lambda)
 {
-    return val == tail_token;
+    obj_t *iter, *dep, *binding;
+
+    for (iter = node_ref(lambda, LAMBDA_MACROS); pairp(iter);
+            iter = pair_cdr(iter)) {
+        dep = pair_car(iter);
+        if (pair_cdr(pair_car(dep)) != pair_cdr(dep))
+            return 1;
+    }
+    for (iter = node_ref(lambda, LAMBDA_CALLS); pairp(iter);
+            iter = pair_cdr(iter)) {
+        binding = environ_lookup(env, pair_car(iter), EL_LOOK_OUTER);
+        if (binding && macrop(pair_cdr(binding)))
+            return 1;
+    }
+    return 0;
 }
 
-// Language defs
+// Forget the analysis so that the body will be analysed again.
+void
+slang_lambda_reset(obj_t **frame, obj_t *lambda)
+{
+    node_set(lambda, LAMBDA_BODY, nil_wrap());
+    node_set(lambda, LAMBDA_NAMES, nil_wrap());
+    node_set(lambda, LAMBDA_PENDING, nil_wrap());
+    node_set(lambda, LAMBDA_MACROS, nil_wrap());
+    node_set(lambda, LAMBDA_CODE, nil_wrap());
+    node_set(lambda, LAMBDA_CALLS, nil_wrap());
+    node_set_ival(lambda, 0);
+    SGC_ROOT1(frame, lambda);
+    scope_add_formals(frame, lambda);
+}
+
+obj_t *
+slang_lambda_code(obj_t *lambda)
+{
+    return node_ref(lambda, LAMBDA_CODE);
+}
+
+void
+slang_lambda_set_code(obj_t *lambda, obj_t *code)
+{
+    node_set(lambda, LAMBDA_CODE, code);
+}
+
+// main entrance for analysis.
+// The environment of the frame is used to look up syntactic keywords.
+obj_t *
+slang_analyze(obj_t **frame, obj_t *scope)
+{
+    obj_t *expr = *frame_ref(frame, 0);
+    obj_t *node;
+
+    switch (get_type(expr)) {
+
+    case TP_PAIR:
+        {
+            obj_t *car = pair_car(expr);
+            obj_t *binding = NULL;
+            bool_t global = symbolp(car) && !is_lexically_bound(scope, car);
+
+            if (global) {
+                binding = environ_lookup(frame_env(frame), car,
+                                         EL_LOOK_OUTER);
+            }
+            if (binding) {
+                obj_t *syntax = pair_cdr(binding);
+                if (specformp(syntax)) {
+                    obj_t **ex_frame = frame_extend(frame, 1,
+                            FR_SAVE_PREV | FR_CONTINUE_ENV);
+                    *frame_ref(ex_frame, 0) = pair_cdr(expr);
+                    return specform_unwrap(syntax)(ex_frame, scope);
+                }
+                else if (macrop(syntax)) {
+                    // Expand once and analyse the expansion instead.
+                    // The expansion is kept until the macro is rebound.
+                    obj_t **ex_frame = frame_extend(frame, 1,
+                            FR_SAVE_PREV | FR_CONTINUE_ENV);
+                    if (!nullp(scope)) {
+                        add_macro_dependency(frame, scope_host(scope),
+                                             binding);
+                    }
+                    *frame_ref(ex_frame, 0) = macro_expand(
+                            frame, syntax, pair_cdr(expr));
+                    return slang_analyze(ex_frame, scope);
+                }
+            }
+            if (global && !nullp(scope)) {
+                // The name may be bound to a macro later.
+                add_call_dependency(frame, scope_host(scope), car);
+            }
+            return analyze_call(frame, scope);
+        }
+
+    case TP_SYMBOL:
+        return analyze_symbol(frame, scope);
+
+    case TP_NIL:
+        fatal_error("empty application", frame);
+        break;
+
+    default:
+        // Self-evaluating
+        node = node_wrap(frame, ND_CONST, 1);
+        node_set(node, 0, expr);
+        return node;
+    }
+    NOT_REACHED();
+}
+
+// Analyse the body of a lambda node, which is done when its closure
+// is called for the first time.
+void
+slang_analyze_lambda(obj_t **frame, obj_t *lambda)
+{
+    obj_t *iter, *node, *body;
+    long slot;
+
+    if (slang_lambda_analyzedp(lambda))
+        return;
+
+    frame = frame_extend(frame, 2, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 1) = lambda;
+    for (;;) {
+        *frame_ref(frame, 0) = node_ref(lambda, LAMBDA_SOURCE);
+        body = analyze_body(frame, lambda);
+
+        // Fix up the references which turned out to be local.
+        for (iter = node_ref(lambda, LAMBDA_PENDING); pairp(iter);
+                iter = pair_cdr(iter)) {
+            node = pair_car(iter);
+            slot = scope_slot(lambda, node_ref(node, 0));
+            if (slot >= 0) {
+                switch (node_kind(node)) {
+                case ND_LREF:
+                case ND_GREF:
+                    node_set_kind(node, ND_LREF);
+                    break;
+                default:
+                    node_set_kind(node, ND_LSET);
+                    node_set_ival(lambda,
+                                  node_ival(lambda) | LAMBDA_CAPTURED);
+                    break;
+                }
+                node_set_ival(node, 0);
+                node_set_slot(node, slot);
+            }
+        }
+        node_set(lambda, LAMBDA_PENDING, nil_wrap());
+        if ((node_ival(lambda) & (LAMBDA_CAPTURED | LAMBDA_LET_BLOCKS)) !=
+                (LAMBDA_CAPTURED | LAMBDA_LET_BLOCKS)) {
+            break;
+        }
+
+        // The blocks share the captured env, analyse the body again
+        // with the binding forms made into lambdas.
+        node_set(lambda, LAMBDA_NAMES, nil_wrap());
+        node_set(lambda, LAMBDA_MACROS, nil_wrap());
+        node_set(lambda, LAMBDA_CALLS, nil_wrap());
+        node_set_ival(lambda, LAMBDA_LET_ENVS);
+        scope_add_formals(frame, lambda);
+    }
+    node_set(lambda, LAMBDA_BODY, body);
+    node_set_ival(lambda, node_ival(lambda) | LAMBDA_ANALYZED);
+}
 
+bool_t
+slang_lambda_analyzedp(obj_t *lambda)
+{
+    return node_ival(lambda) & LAMBDA_ANALYZED;
+}
+
+bool_t
+slang_lambda_capturedp(obj_t *lambda)
+{
+    return (node_ival(lambda) & LAMBDA_CAPTURED) != 0;
+}
+
+obj_t *
+slang_lambda_body(obj_t *lambda)
+{
+    return node_ref(lambda, LAMBDA_BODY);
+}
+
+obj_t *
+slang_lambda_formals(obj_t *lambda)
+{
+    return node_ref(lambda, LAMBDA_FORMALS);
+}
+
+size_t
+slang_lambda_nb_slots(obj_t *lambda)
+{
+    obj_t *iter;
+    size_t nb_slots = 0;
+    for (iter = node_ref(lambda, LAMBDA_NAMES); pairp(iter);
+            iter = pair_cdr(iter)) {
+        ++nb_slots;
+    }
+    return nb_slots;
+}
+
+// Analyse expr on a fresh frame so that the caller's slots are kept.
 static obj_t *
-lang_if(obj_t **frame, obj_t **tailp)
+analyze_sub(obj_t **frame, obj_t *expr, obj_t *scope)
+{
+    obj_t **ex_frame = frame_extend(frame, 1,
+            FR_SAVE_PREV | FR_CONTINUE_ENV);
+    *frame_ref(ex_frame, 0) = expr;
+    return slang_analyze(ex_frame, scope);
+}
+
+static obj_t *
+analyze_symbol(obj_t **frame, obj_t *scope)
+{
+    obj_t *name = *frame_ref(frame, 0);
+    obj_t *node;
+
+    SGC_ROOT1(frame, scope);
+    node = node_wrap(frame, ND_GREF, 1);
+    node_set(node, 0, name);
+    resolve_variable(frame, node, scope, 0);
+    return node;
+}
+
+static obj_t *
+analyze_call(obj_t **frame, obj_t *scope)
 {
     obj_t *expr = *frame_ref(frame, 0);
-    obj_t *pred, *todo, *otherwise;
-    *tailp = tail_token;
+    obj_t *iter, *node;
+    long argc = 0;
+    long i;
 
-    pred = pair_car(expr);
-    todo = pair_cadr(expr);
-    otherwise = pair_cddr(expr);
-    if (nullp(otherwise)) {
-        otherwise = unspec_wrap();
+    for (iter = expr; pairp(iter); iter = pair_cdr(iter)) {
+        ++argc;
     }
-    else if (!nullp(pair_cdr(otherwise))) {
-        fatal_error("if -- too many arguments", frame);
+    if (!nullp(iter)) {
+        fatal_error("not a well-formed list", frame);
     }
-    else {
-        otherwise = pair_car(otherwise);
+
+    // [expr, node, scope]
+    frame = frame_extend(frame, 3, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    *frame_ref(frame, 2) = scope;
+    node = node_wrap(frame, ND_CALL, argc);
+    *frame_ref(frame, 1) = node;
+
+    for (i = 0, iter = expr; i < argc; ++i, iter = pair_cdr(iter)) {
+        node_set(node, i, analyze_sub(frame, pair_car(iter), scope));
     }
+    return node;
+}
+
+// A list of expressions into a sequence, used by lambda and begin.
+static obj_t *
+analyze_body(obj_t **frame, obj_t *scope)
+{
+    obj_t *body = *frame_ref(frame, 0);
+    obj_t *iter, *node;
+    long len = 0;
+    long i;
 
-    {
-        // start to evaluate the predicate.
-        obj_t **pred_frame = frame_extend(
-                frame, 1, FR_CONTINUE_ENV | FR_SAVE_PREV);
-        *frame_ref(pred_frame, 0) = pred;
-        pred = eval_frame(pred_frame);
+    for (iter = body; pairp(iter); iter = pair_cdr(iter)) {
+        ++len;
+    }
+    if (!nullp(iter)) {
+        fatal_error("begin -- not a well-formed list", frame);
+    }
+    if (len == 0) {
+        // Empty (begin) expression
+        node = node_wrap(frame, ND_CONST, 1);
+        node_set(node, 0, unspec_wrap());
+        return node;
+    }
+    if (len == 1) {
+        return analyze_sub(frame, pair_car(body), scope);
     }
-    if (to_boolean(pred)) {
-        return todo;
+
+    // [body, node, scope]
+    frame = frame_extend(frame, 3, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = body;
+    *frame_ref(frame, 2) = scope;
+    node = node_wrap(frame, ND_SEQ, len);
+    *frame_ref(frame, 1) = node;
+
+    for (i = 0, iter = body; i < len; ++i, iter = pair_cdr(iter)) {
+        node_set(node, i, analyze_sub(frame, pair_car(iter), scope));
+    }
+    return node;
+}
+
+// Language defs
+
+static obj_t *
+lang_if(obj_t **frame, obj_t *scope)
+{
+    obj_t *expr = *frame_ref(frame, 0);
+    obj_t *node, *otherwise;
+
+    if (!pairp(expr) || !pairp(pair_cdr(expr))) {
+        fatal_error("if -- too few arguments", frame);
+    }
+    otherwise = pair_cddr(expr);
+    if (!nullp(otherwise) && !nullp(pair_cdr(otherwise))) {
+        fatal_error("if -- too many arguments", frame);
+    }
+
+    frame = frame_extend(frame, 3, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    *frame_ref(frame, 2) = scope;
+    node = node_wrap(frame, ND_IF, 3);
+    *frame_ref(frame, 1) = node;
+
+    node_set(node, 0, analyze_sub(frame, pair_car(expr), scope));
+    node_set(node, 1, analyze_sub(frame, pair_cadr(expr), scope));
+    if (nullp(otherwise)) {
+        node_set(node, 2, analyze_sub(frame, unspec_wrap(), scope));
     }
     else {
-        return otherwise;
+        node_set(node, 2, analyze_sub(frame, pair_car(otherwise), scope));
+    }
+    return node;
+}
+
+static obj_t *
+make_lambda(obj_t **frame, obj_t *formals, obj_t *body, obj_t *scope)
+{
+    obj_t *node;
+
+    if (!nullp(scope)) {
+        obj_t *host = scope_host(scope);
+        node_set_ival(host, node_ival(host) | LAMBDA_CAPTURED);
     }
+    SGC_ROOT3(frame, formals, body, scope);
+    node = node_wrap(frame, ND_LAMBDA, NB_LAMBDA_KIDS);
+    node_set(node, LAMBDA_FORMALS, formals);
+    node_set(node, LAMBDA_BODY, nil_wrap());
+    node_set(node, LAMBDA_PARENT, scope);
+    node_set(node, LAMBDA_NAMES, nil_wrap());
+    node_set(node, LAMBDA_PENDING, nil_wrap());
+    node_set(node, LAMBDA_SOURCE, body);
+    node_set(node, LAMBDA_MACROS, nil_wrap());
+    node_set(node, LAMBDA_CODE, nil_wrap());
+    node_set(node, LAMBDA_CALLS, nil_wrap());
+    SGC_ROOT1(frame, node);
+    scope_add_formals(frame, node);
+    return node;
 }
 
 static obj_t *
-lang_lambda(obj_t **frame, obj_t **tailp)
+lang_lambda(obj_t **frame, obj_t *scope)
 {
     obj_t *expr = *frame_ref(frame, 0);
-    *tailp = NULL;
-    return closure_wrap(frame, frame_env(frame),
-                        pair_car(expr), pair_cdr(expr));
+    if (!pairp(expr)) {
+        fatal_error("lambda -- missing formals", frame);
+    }
+    return make_lambda(frame, pair_car(expr), pair_cdr(expr), scope);
 }
 
 static obj_t *
-lang_define(obj_t **frame, obj_t **tailp)
+lang_define(obj_t **frame, obj_t *scope)
 {
     obj_t *expr = *frame_ref(frame, 0);
-    obj_t *first, *name, *result;
-    *tailp = NULL;
+    obj_t *first, *name, *node;
+
+    if (!pairp(expr)) {
+        fatal_error("define -- missing arguments", frame);
+    }
     first = pair_car(expr);
+    frame = frame_extend(frame, 3, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    *frame_ref(frame, 2) = scope;
+    node = node_wrap(frame, ND_DEFINE, 2);
+    *frame_ref(frame, 1) = node;
+
     if (symbolp(first)) {
         // Binding an expression
         // XXX: check for expr length?
-        obj_t *to_eval = pair_car(pair_cdr(expr));
-        // Get the value of the expression before binding.
-        obj_t **expr_frame = frame_extend(
-                frame, 1, FR_CONTINUE_ENV | FR_SAVE_PREV);
-        *frame_ref(expr_frame, 0) = to_eval;
-        result = eval_frame(expr_frame);
         name = first;
+        // Define first so that the value may refer to it.
+        scope_add_name(frame, scope, name);
+        node_set(node, 1, analyze_sub(frame, pair_cadr(expr), scope));
     }
     else if (pairp(first)) {
         // short hand for (define name (lambda ...))
-        // x: the formals, v: the body
-        obj_t *formals, *body;
         name = pair_car(first);
-        formals = pair_cdr(first);
-        body = pair_cdr(expr);
-        result = closure_wrap(frame, frame_env(frame), formals, body);
+        if (!symbolp(name)) {
+            fatal_error("define -- name is not a symbol", frame);
+        }
+        scope_add_name(frame, scope, name);
+        node_set(node, 1, make_lambda(frame, pair_cdr(first),
+                                      pair_cdr(expr), scope));
     }
     else {
         fatal_error("define -- first argument is neither a "
                     "symbol nor a pair", frame);
     }
-    environ_def(frame, frame_env(frame), name, result);
-    return unspec_wrap();
+    node_set(node, 0, name);
+    if (!nullp(scope)) {
+        // The uses of a local name are analysed as calls, before the
+        // macro exists, so the macros are only expanded from the
+        // toplevel env.
+        if (node_kind(node_ref(node, 1)) == ND_MACRO) {
+            fatal_error("define -- a macro can't be defined in a body",
+                        frame);
+        }
+        // An internal define is just an assignment to its slot.
+        node_set_kind(node, ND_LSET);
+        node_set_slot(node, scope_slot(scope, name));
+    }
+    return node;
 }
 
 static obj_t *
-lang_set(obj_t **frame, obj_t **tailp)
+lang_set(obj_t **frame, obj_t *scope)
 {
     obj_t *expr = *frame_ref(frame, 0);
-    obj_t *first, *name, *result;
-    *tailp = NULL;
-    first = pair_car(expr);
-    if (symbolp(first)) {
-        // Binding an expression
-        // XXX: check for expr length?
-        obj_t *to_eval = pair_car(pair_cdr(expr));
-        // Get the value of the expression before binding.
-        obj_t **expr_frame = frame_extend(
-                frame, 1, FR_CONTINUE_ENV | FR_SAVE_PREV);
-        *frame_ref(expr_frame, 0) = to_eval;
-        result = eval_frame(expr_frame);
-        name = first;
+    obj_t *node;
+
+    if (!pairp(expr) || !symbolp(pair_car(expr))) {
+        fatal_error("set! -- first argument is not a symbol", frame);
+    }
+    // XXX: check for expr length?
+    frame = frame_extend(frame, 3, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    *frame_ref(frame, 2) = scope;
+    node = node_wrap(frame, ND_GSET, 2);
+    *frame_ref(frame, 1) = node;
+
+    node_set(node, 0, pair_car(expr));
+    node_set(node, 1, analyze_sub(frame, pair_cadr(expr), scope));
+    resolve_variable(frame, node, scope, 1);
+    return node;
+}
+
+static obj_t *
+lang_begin(obj_t **frame, obj_t *scope)
+{
+    return analyze_body(frame, scope);
+}
+
+static obj_t *
+lang_quote(obj_t **frame, obj_t *scope)
+{
+    obj_t *expr = *frame_ref(frame, 0);
+    obj_t *node;
+
+    if (nullp(expr) || !nullp(pair_cdr(expr))) {
+        fatal_error("quote -- wrong number of argument", frame);
+    }
+    node = node_wrap(frame, ND_CONST, 1);
+    node_set(node, 0, pair_car(expr));
+    return node;
+}
+
+// Quasiquote templates are analysed into ND_CONS and ND_APPEND nodes
+// around the unquoted expressions. The parts without unquotes are kept
+// as constants, shared by all the expansions. Depth is the number of
+// quasiquotes nested in the template, which unquotes have to cancel.
+
+// Whether the template is (keyword datum).
+static bool_t
+template_formp(obj_t *content, obj_t *keyword)
+{
+    return pairp(content) && pair_car(content) == keyword &&
+           pairp(pair_cdr(content)) && nullp(pair_cddr(content));
+}
+
+static obj_t *
+make_const(obj_t **frame, obj_t *value)
+{
+    obj_t *node;
+
+    SGC_ROOT1(frame, value);
+    node = node_wrap(frame, ND_CONST, 1);
+    node_set(node, 0, value);
+    return node;
+}
+
+static obj_t *
+analyze_template(obj_t **frame, obj_t *content, obj_t *scope, long depth)
+{
+    obj_t *item, *node;
+    long cdr_depth = depth;
+
+    if (!pairp(content)) {
+        return make_const(frame, content);
+    }
+    if (template_formp(content, symbol_unquote) ||
+            template_formp(content, symbol_unquote_splicing)) {
+        if (depth == 0) {
+            if (pair_car(content) == symbol_unquote_splicing) {
+                fatal_error("unquote-splicing -- not in a list", frame);
+            }
+            return analyze_sub(frame, pair_cadr(content), scope);
+        }
+        cdr_depth = depth - 1;
+    }
+    else if (template_formp(content, symbol_quasiquote)) {
+        cdr_depth = depth + 1;
+    }
+
+    // [content, scope, node]
+    frame = frame_extend(frame, 3, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = content;
+    *frame_ref(frame, 1) = scope;
+    item = pair_car(content);
+    if (depth == 0 && template_formp(item, symbol_unquote_splicing)) {
+        node = node_wrap(frame, ND_APPEND, 2);
+        *frame_ref(frame, 2) = node;
+        node_set(node, 0, analyze_sub(frame, pair_cadr(item), scope));
     }
     else {
-        fatal_error("set! -- first argument is not a symbol", frame);
+        node = node_wrap(frame, ND_CONS, 2);
+        *frame_ref(frame, 2) = node;
+        node_set(node, 0, analyze_template(frame, item, scope, depth));
+    }
+    node_set(node, 1, analyze_template(frame, pair_cdr(content), scope,
+                                       cdr_depth));
+    if (node_kind(node) == ND_CONS &&
+            node_kind(node_ref(node, 0)) == ND_CONST &&
+            node_kind(node_ref(node, 1)) == ND_CONST) {
+        return make_const(frame, content);
     }
-    environ_set(frame_env(frame), name, result);
-    return unspec_wrap();
+    return node;
 }
 
 static obj_t *
-lang_begin(obj_t **frame, obj_t **tailp)
+lang_quasiquote(obj_t **frame, obj_t *scope)
 {
     obj_t *expr = *frame_ref(frame, 0);
-    *tailp = tail_token;
-    obj_t *iter;
+    if (nullp(expr) || !nullp(pair_cdr(expr))) {
+        fatal_error("quasiquote -- wrong number of argument", frame);
+    }
+    return analyze_template(frame, pair_car(expr), scope, 0);
+}
 
-    for (iter = expr; pairp(iter); iter = pair_cdr(iter)) {
-        // Eval each expression except the last.
-        if (!pairp(pair_cdr(iter))) {
-            break;
+static obj_t *
+lang_lambda_syntax(obj_t **frame, obj_t *scope)
+{
+    obj_t *expr = *frame_ref(frame, 0);
+    obj_t *node, *lambda;
+
+    // LOL!!!
+    if (!pairp(expr)) {
+        fatal_error("lambda-syntax -- missing formals", frame);
+    }
+    lambda = make_lambda(frame, pair_car(expr), pair_cdr(expr), scope);
+    SGC_ROOT1(frame, lambda);
+    node = node_wrap(frame, ND_MACRO, 1);
+    node_set(node, 0, lambda);
+    return node;
+}
+
+// Binding forms, @see the block scopes above.
+// At the toplevel there's no env to host the names, so the form is put
+// in a lambda which is applied on the spot.
+static obj_t *
+wrap_toplevel(obj_t **frame, obj_t *keyword)
+{
+    obj_t *body, *node;
+
+    body = pair_wrap(frame, keyword, *frame_ref(frame, 0));
+    body = pair_wrap(frame, body, nil_wrap());
+    SGC_ROOT1(frame, body);
+    node = node_wrap(frame, ND_CALL, 1);
+    SGC_ROOT1(frame, node);
+    node_set(node, 0, make_lambda(frame, nil_wrap(), body, nil_wrap()));
+    return node;
+}
+
+static obj_t *
+make_block(obj_t **frame, obj_t *scope)
+{
+    obj_t *block;
+
+    SGC_ROOT1(frame, scope);
+    block = node_wrap(frame, ND_LAMBDA, NB_LAMBDA_KIDS);
+    node_set(block, LAMBDA_PARENT, scope);
+    node_set(block, LAMBDA_NAMES, nil_wrap());
+    node_set_ival(block, LAMBDA_BLOCK);
+    return block;
+}
+
+// Assign the value to the name, which is bound in the block.
+static obj_t *
+block_bind(obj_t **frame, obj_t *block, obj_t *name, obj_t *value)
+{
+    obj_t *node;
+
+    SGC_ROOT3(frame, block, name, value);
+    scope_add_name(frame, block, name);
+    node = node_wrap(frame, ND_LSET, 2);
+    node_set(node, 0, name);
+    node_set(node, 1, value);
+    node_set_slot(node, scope_slot(block, name));
+    return node;
+}
+
+static obj_t *
+block_ref(obj_t **frame, obj_t *block, obj_t *name)
+{
+    obj_t *node;
+
+    SGC_ROOT2(frame, block, name);
+    node = node_wrap(frame, ND_LREF, 1);
+    node_set(node, 0, name);
+    node_set_slot(node, scope_slot(block, name));
+    return node;
+}
+
+static obj_t *
+analyze_block_body(obj_t **frame, obj_t *body, obj_t *block)
+{
+    obj_t **ex_frame = frame_extend(frame, 1,
+            FR_SAVE_PREV | FR_CONTINUE_ENV);
+    *frame_ref(ex_frame, 0) = body;
+    return analyze_body(ex_frame, block);
+}
+
+// Count the bindings, which are (name init) or (name init step) when
+// steps are allowed.
+static long
+count_bindings(obj_t **frame, obj_t *bindings, bool_t allow_step,
+               const char *msg)
+{
+    obj_t *iter, *binding;
+    long len = 0;
+
+    for (iter = bindings; pairp(iter); iter = pair_cdr(iter), ++len) {
+        binding = pair_car(iter);
+        if (!pairp(binding) || !symbolp(pair_car(binding)) ||
+                !pairp(pair_cdr(binding))) {
+            fatal_error(msg, frame);
+        }
+        binding = pair_cddr(binding);
+        if (allow_step && pairp(binding)) {
+            binding = pair_cdr(binding);
+        }
+        if (!nullp(binding)) {
+            fatal_error(msg, frame);
         }
-        obj_t **expr_frame = frame_extend(frame, 1,
-                FR_SAVE_PREV | FR_CONTINUE_ENV);
-        *frame_ref(expr_frame, 0) = pair_car(iter);
-        eval_frame(expr_frame);
     }
-    if (nullp(iter)) {
-        // Empty (begin) expression
-        return unspec_wrap();
+    if (!nullp(iter)) {
+        fatal_error(msg, frame);
     }
-    else if (!nullp(pair_cdr(iter))) {
-        fatal_error("begin -- not a well-formed list", frame);
+    return len;
+}
+
+// The list of the index-th item of each binding, or of its name when
+// the binding is shorter.
+static obj_t *
+binding_column(obj_t **frame, obj_t *bindings, long index)
+{
+    obj_t *binding, *rest;
+    long i;
+
+    if (!pairp(bindings)) {
+        return nil_wrap();
+    }
+    rest = binding_column(frame, pair_cdr(bindings), index);
+    binding = pair_car(bindings);
+    for (i = 0; i < index && pairp(pair_cdr(binding)); ++i) {
+        binding = pair_cdr(binding);
+    }
+    if (i < index) {
+        binding = pair_car(bindings);
+    }
+    return pair_wrap(frame, pair_car(binding), rest);
+}
+
+// Whether the binding forms of the scope are made into lambdas, which
+// give each entry its own env. Otherwise they're made into blocks.
+static bool_t
+let_envp(obj_t *scope)
+{
+    obj_t *host = scope_host(scope);
+
+    if (node_ival(host) & LAMBDA_LET_ENVS) {
+        return 1;
+    }
+    node_set_ival(host, node_ival(host) | LAMBDA_LET_BLOCKS);
+    return 0;
+}
+
+// ((lambda formals . body) init ...) for the bindings (name init) ...
+static obj_t *
+make_let_lambda(obj_t **frame, obj_t *scope, obj_t *bindings, obj_t *body,
+                long len)
+{
+    obj_t *node, *formals, *iter;
+    long i;
+
+    // [bindings, body, scope, node]
+    frame = frame_extend(frame, 4, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = bindings;
+    *frame_ref(frame, 1) = body;
+    *frame_ref(frame, 2) = scope;
+    node = node_wrap(frame, ND_CALL, len + 1);
+    *frame_ref(frame, 3) = node;
+
+    formals = binding_column(frame, bindings, 0);
+    node_set(node, 0, make_lambda(frame, formals, body, scope));
+    for (i = 1, iter = bindings; i <= len; ++i, iter = pair_cdr(iter)) {
+        node_set(node, i, analyze_sub(frame, pair_cadr(pair_car(iter)),
+                                      scope));
     }
-    return pair_car(iter);
+    return node;
 }
 
+// (name bindings . body) into the application of a loop lambda, which
+// is bound to the name in a new block. The tail calls of the loop are
+// made in place, so it runs in constant stack space.
 static obj_t *
-lang_quote(obj_t **frame, obj_t **tailp)
+make_loop(obj_t **frame, obj_t *scope, long len)
 {
     obj_t *expr = *frame_ref(frame, 0);
-    *tailp = NULL;
+    obj_t *node, *call, *block, *iter;
+    long i;
 
-    if (nullp(expr) || !nullp(pair_cdr(expr))) {
-        fatal_error("quote -- wrong number of argument", frame);
+    // [expr, node, block, scope, call]
+    frame = frame_extend(frame, 5, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    *frame_ref(frame, 3) = scope;
+    block = make_block(frame, scope);
+    *frame_ref(frame, 2) = block;
+    node = node_wrap(frame, ND_SEQ, 2);
+    *frame_ref(frame, 1) = node;
+
+    call = binding_column(frame, pair_cadr(expr), 0);
+    call = make_lambda(frame, call, pair_cddr(expr), block);
+    node_set(node, 0, block_bind(frame, block, pair_car(expr), call));
+
+    // The inits are analysed out of the block.
+    call = node_wrap(frame, ND_CALL, len + 1);
+    *frame_ref(frame, 4) = call;
+    node_set(call, 0, block_ref(frame, block, pair_car(expr)));
+    for (i = 1, iter = pair_cadr(expr); i <= len; ++i, iter = pair_cdr(iter)) {
+        node_set(call, i, analyze_sub(frame, pair_cadr(pair_car(iter)),
+                                      scope));
     }
-    return pair_car(expr);
+    node_set(node, 1, call);
+    return node;
 }
 
-enum quasiquote_return_flag {
-    QQ_DEFAULT = 0,
-    QQ_UNQUOTE = 1,
-    QQ_SPLICING = 2
-};
+static obj_t *
+lang_let(obj_t **frame, obj_t *scope)
+{
+    obj_t *expr = *frame_ref(frame, 0);
+    obj_t *node, *block, *iter;
+    long len, i;
+
+    if (!pairp(expr) || (symbolp(pair_car(expr)) && !pairp(pair_cdr(expr)))) {
+        fatal_error("let -- missing bindings", frame);
+    }
+    if (nullp(scope)) {
+        return wrap_toplevel(frame, symbol_let);
+    }
+    if (symbolp(pair_car(expr))) {
+        len = count_bindings(frame, pair_cadr(expr), 0,
+                             "let -- malformed bindings");
+        return make_loop(frame, scope, len);
+    }
+    len = count_bindings(frame, pair_car(expr), 0,
+                         "let -- malformed bindings");
+    if (let_envp(scope)) {
+        return make_let_lambda(frame, scope, pair_car(expr), pair_cdr(expr),
+                               len);
+    }
 
+    // [expr, node, block, scope]
+    frame = frame_extend(frame, 4, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    *frame_ref(frame, 3) = scope;
+    block = make_block(frame, scope);
+    *frame_ref(frame, 2) = block;
+    node = node_wrap(frame, ND_SEQ, len + 1);
+    *frame_ref(frame, 1) = node;
+
+    // The inits are analysed out of the block.
+    for (i = 0, iter = pair_car(expr); i < len; ++i, iter = pair_cdr(iter)) {
+        node_set(node, i, block_bind(frame, block, pair_caar(iter),
+                analyze_sub(frame, pair_cadr(pair_car(iter)), scope)));
+    }
+    node_set(node, len, analyze_block_body(frame, pair_cdr(expr), block));
+    return node;
+}
+
+// (let* (binding . rest) . body) is made
+// (let (binding) (let* rest . body))
 static obj_t *
-expand_quasiquote(obj_t **frame, obj_t *content,
-                  enum quasiquote_return_flag *flag)
+let_star_lambda(obj_t **frame, obj_t *scope, long len)
 {
-    if (!pairp(content)) {
-        return content;
-    }
-
-    // Manually compare each item with unquote/unquote-splicing
-    obj_t *qq = symbol_quasiquote;
-    obj_t *uq = symbol_unquote;
-    obj_t *spl = symbol_unquote_splicing;
-
-    if (pair_car(content) == qq) {
-        if (flag)
-            flag = QQ_DEFAULT;
-        return content;
-        // XXX: NESTED QQ...
-        /*
-        obj_t *body = pair_cadr(content);
-        frame = frame_extend(frame, 1, FR_SAVE_PREV | FR_CONTINUE_ENV);
-        *frame_ref(frame, 0) = content;
-        obj_t *res = expand_quasiquote(frame, body, NULL);  // nested QQ
-        obj_t *wrap = pair_wrap(frame, res, nil_wrap());
-        return pair_wrap(frame, qq, wrap);
-        */
-    }
-    else if (pair_car(content) == uq) {
-        obj_t *uq_body = pair_cadr(content);
-        frame = frame_extend(frame, 1, FR_SAVE_PREV | FR_CONTINUE_ENV);
-        *frame_ref(frame, 0) = uq_body;
-        if (flag)
-            *flag = QQ_UNQUOTE;
-        return eval_frame(frame);
-    }
-    else if (pair_car(content) == spl) {
-        obj_t *spl_body = pair_cadr(content);
-        obj_t *retval;
-        frame = frame_extend(frame, 1, FR_SAVE_PREV | FR_CONTINUE_ENV);
-        *frame_ref(frame, 0) = spl_body;
-        retval = eval_frame(frame);
-        if (flag)
-            *flag = QQ_SPLICING;
-        return retval;
+    obj_t *expr = *frame_ref(frame, 0);
+    obj_t *body, *bindings;
+
+    if (len <= 1) {
+        return make_let_lambda(frame, scope, pair_car(expr), pair_cdr(expr),
+                               len);
     }
-    else {
-        // Copy the pair content.
-        content = pair_copy_list(frame, content);
-        // Append a dummy header for unquote-splicing to use.
-        content = pair_wrap(frame, nil_wrap(), content);
-
-        // Mark the content.
-        frame = frame_extend(frame, 1, FR_SAVE_PREV | FR_CONTINUE_ENV);
-        *frame_ref(frame, 0) = content;
-
-        // For linking unquote-splicing, we look at the next item of
-        // the iterator. That's why we need a dummy header here.
-        obj_t *iter, *next, *got;
-        enum quasiquote_return_flag ret_flag;
-
-        for (iter = content; pairp(iter); iter = pair_cdr(iter)) {
-            // `next` will always be null or pair, since `content` is a list.
-loop_begin:
-            next = pair_cdr(iter);
-            if (nullp(next))  // we are done.
-                break;
-
-            // XXX: this is strange. why do we need to initialize it?
-            ret_flag = QQ_DEFAULT;
-            got = expand_quasiquote(frame, pair_car(next), &ret_flag);
-            if (ret_flag & QQ_SPLICING) {
-                // Special handling for unquote-splicing
-                // WARNING: messy code below!
-                got = pair_copy_list(frame, got);
-
-                if (nullp(got)) {
-                    pair_set_cdr(iter, pair_cdr(next));
-                }
-                else {
-                    pair_set_cdr(iter, got);  // iter -> got
-                    while (pairp(pair_cdr(got))) {
-                        got = pair_cdr(got);
-                    }
-                    pair_set_cdr(got, pair_cdr(next));  // got -> (next->next)
-                    iter = got;  // make sure the next iteration is correct
-                    goto loop_begin;  // And this...
-                }
-            }
-            else {
-                // Not unquote-splicing, easy...
-                pair_set_car(next, got);
+
+    // [expr, body, scope]
+    frame = frame_extend(frame, 3, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    *frame_ref(frame, 2) = scope;
+    body = pair_wrap(frame, pair_cdr(pair_car(expr)), pair_cdr(expr));
+    body = pair_wrap(frame, symbol_let_star, body);
+    body = pair_wrap(frame, body, nil_wrap());
+    *frame_ref(frame, 1) = body;
+    bindings = pair_wrap(frame, pair_caar(expr), nil_wrap());
+    return make_let_lambda(frame, scope, bindings, *frame_ref(frame, 1), 1);
+}
+
+// (letrec ((name init) ...) . body) is made
+// ((lambda () (define name init) ... . body))
+static obj_t *
+letrec_lambda(obj_t **frame, obj_t *scope)
+{
+    obj_t *expr = *frame_ref(frame, 0);
+    obj_t *body, *iter;
+
+    SGC_ROOT1(frame, scope);
+    body = pair_copy_list(frame, pair_car(expr));
+    SGC_ROOT1(frame, body);
+    for (iter = body; pairp(iter); iter = pair_cdr(iter)) {
+        pair_set_car(iter, pair_wrap(frame, symbol_define, pair_car(iter)));
+    }
+    body = pair_append(frame, body, pair_cdr(expr));
+    return make_let_lambda(frame, scope, nil_wrap(), body, 0);
+}
+
+static obj_t *
+lang_let_star(obj_t **frame, obj_t *scope)
+{
+    obj_t *expr = *frame_ref(frame, 0);
+    obj_t *node, *block, *value, *iter;
+    long len, i;
+
+    if (!pairp(expr)) {
+        fatal_error("let* -- missing bindings", frame);
+    }
+    if (nullp(scope)) {
+        return wrap_toplevel(frame, symbol_let_star);
+    }
+    len = count_bindings(frame, pair_car(expr), 0,
+                         "let* -- malformed bindings");
+    if (let_envp(scope)) {
+        return let_star_lambda(frame, scope, len);
+    }
+
+    // [expr, node, block, value]
+    frame = frame_extend(frame, 4, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    node = node_wrap(frame, ND_SEQ, len + 1);
+    *frame_ref(frame, 1) = node;
+    block = make_block(frame, scope);
+    *frame_ref(frame, 2) = block;
+
+    // Each init sees the names bound before, in a block of its own.
+    for (i = 0, iter = pair_car(expr); i < len; ++i, iter = pair_cdr(iter)) {
+        value = analyze_sub(frame, pair_cadr(pair_car(iter)), block);
+        *frame_ref(frame, 3) = value;
+        if (i > 0) {
+            block = make_block(frame, block);
+            *frame_ref(frame, 2) = block;
+        }
+        node_set(node, i, block_bind(frame, block, pair_caar(iter), value));
+    }
+    node_set(node, len, analyze_block_body(frame, pair_cdr(expr), block));
+    return node;
+}
+
+static obj_t *
+lang_letrec(obj_t **frame, obj_t *scope)
+{
+    obj_t *expr = *frame_ref(frame, 0);
+    obj_t *node, *block, *iter;
+    long len, i;
+
+    if (!pairp(expr)) {
+        fatal_error("letrec -- missing bindings", frame);
+    }
+    if (nullp(scope)) {
+        return wrap_toplevel(frame, symbol_letrec);
+    }
+    len = count_bindings(frame, pair_car(expr), 0,
+                         "letrec -- malformed bindings");
+    if (let_envp(scope)) {
+        return letrec_lambda(frame, scope);
+    }
+
+    // [expr, node, block]
+    frame = frame_extend(frame, 3, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    block = make_block(frame, scope);
+    *frame_ref(frame, 2) = block;
+    node = node_wrap(frame, ND_SEQ, len + 1);
+    *frame_ref(frame, 1) = node;
+
+    // All the names are bound before the inits are analysed.
+    for (iter = pair_car(expr); pairp(iter); iter = pair_cdr(iter)) {
+        scope_add_name(frame, block, pair_caar(iter));
+    }
+    for (i = 0, iter = pair_car(expr); i < len; ++i, iter = pair_cdr(iter)) {
+        node_set(node, i, block_bind(frame, block, pair_caar(iter),
+                analyze_sub(frame, pair_cadr(pair_car(iter)), block)));
+    }
+    node_set(node, len, analyze_block_body(frame, pair_cdr(expr), block));
+    return node;
+}
+
+// (do ((name init step) ...) (test res ...) command ...) is made a loop
+// under an uninterned name, whose body is
+// (if test (begin res ...) (begin command ... (name step ...)))
+static obj_t *
+lang_do(obj_t **frame, obj_t *scope)
+{
+    obj_t *expr = *frame_ref(frame, 0);
+    obj_t *name, *body, *tmp;
+    long len;
+
+    if (!pairp(expr) || !pairp(pair_cdr(expr)) || !pairp(pair_cadr(expr))) {
+        fatal_error("do -- missing test", frame);
+    }
+    if (nullp(scope)) {
+        return wrap_toplevel(frame, symbol_do);
+    }
+    len = count_bindings(frame, pair_car(expr), 1,
+                         "do -- malformed bindings");
+
+    // [expr, name, body, tmp]
+    frame = frame_extend(frame, 4, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    name = symbol_wrap(frame, "do-loop");
+    *frame_ref(frame, 1) = name;
+
+    body = binding_column(frame, pair_car(expr), 2);
+    body = pair_wrap(frame, name, body);
+    body = pair_wrap(frame, body, nil_wrap());
+    *frame_ref(frame, 2) = body;
+    tmp = pair_copy_list(frame, pair_cddr(expr));
+    if (pairp(tmp)) {
+        *frame_ref(frame, 3) = tmp;
+        while (pairp(pair_cdr(tmp))) {
+            tmp = pair_cdr(tmp);
+        }
+        pair_set_cdr(tmp, body);
+        body = *frame_ref(frame, 3);
+    }
+    body = pair_wrap(frame, symbol_begin, body);
+    *frame_ref(frame, 2) = body;
+    tmp = pair_wrap(frame, symbol_begin, pair_cdr(pair_cadr(expr)));
+    *frame_ref(frame, 3) = tmp;
+    body = pair_wrap(frame, body, nil_wrap());
+    body = pair_wrap(frame, tmp, body);
+    body = pair_wrap(frame, pair_car(pair_cadr(expr)), body);
+    body = pair_wrap(frame, symbol_if, body);
+    body = pair_wrap(frame, body, nil_wrap());
+    *frame_ref(frame, 2) = body;
+
+    // (name bindings . body)
+    body = pair_wrap(frame, pair_car(expr), body);
+    body = pair_wrap(frame, name, body);
+    *frame_ref(frame, 0) = body;
+    return make_loop(frame, scope, len);
+}
+
+// Conditionals are made of ND_IF, ND_OR and ND_CASE nodes, so that each
+// test is evaluated once and the last expressions are in tail position.
+
+// Analyse the rest of a form on a fresh frame, with the given lang def.
+static obj_t *
+analyze_rest(obj_t **frame, sobj_funcptr2_t lang, obj_t *rest,
+             obj_t *scope)
+{
+    obj_t **ex_frame = frame_extend(frame, 1,
+            FR_SAVE_PREV | FR_CONTINUE_ENV);
+    *frame_ref(ex_frame, 0) = rest;
+    return lang(ex_frame, scope);
+}
+
+// (test => receiver) is made
+// (let ((tmp test)) (if tmp (receiver tmp) (cond clause ...)))
+// under an uninterned tmp.
+static obj_t *
+cond_arrow(obj_t **frame, obj_t *scope)
+{
+    obj_t *expr = *frame_ref(frame, 0);
+    obj_t *clause = pair_car(expr);
+    obj_t *tmp, *form, *call;
+
+    if (!pairp(pair_cddr(clause)) || !nullp(pair_cdddr(clause))) {
+        fatal_error("cond -- malformed => clause", frame);
+    }
+
+    // [expr, tmp, form]
+    frame = frame_extend(frame, 3, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    tmp = symbol_wrap(frame, "cond-tmp");
+    *frame_ref(frame, 1) = tmp;
+
+    form = nil_wrap();
+    if (!nullp(pair_cdr(expr))) {
+        form = pair_wrap(frame, symbol_cond, pair_cdr(expr));
+        form = pair_wrap(frame, form, nil_wrap());
+        *frame_ref(frame, 2) = form;
+    }
+    call = pair_wrap(frame, tmp, nil_wrap());
+    call = pair_wrap(frame, pair_caddr(clause), call);
+    form = pair_wrap(frame, call, form);
+    form = pair_wrap(frame, tmp, form);
+    form = pair_wrap(frame, symbol_if, form);
+    form = pair_wrap(frame, form, nil_wrap());
+    *frame_ref(frame, 2) = form;
+    call = pair_wrap(frame, pair_car(clause), nil_wrap());
+    call = pair_wrap(frame, tmp, call);
+    call = pair_wrap(frame, call, nil_wrap());
+    form = pair_wrap(frame, call, form);
+    return analyze_rest(frame, lang_let, form, scope);
+}
+
+static obj_t *
+lang_cond(obj_t **frame, obj_t *scope)
+{
+    obj_t *expr = *frame_ref(frame, 0);
+    obj_t *clause, *node;
+
+    if (nullp(expr)) {
+        return analyze_sub(frame, unspec_wrap(), scope);
+    }
+    if (!pairp(expr) || !pairp(pair_car(expr))) {
+        fatal_error("cond -- malformed clause", frame);
+    }
+    clause = pair_car(expr);
+    if (pair_car(clause) == symbol_else) {
+        if (!nullp(pair_cdr(expr))) {
+            fatal_error("cond -- else is not the last clause", frame);
+        }
+        return analyze_rest(frame, lang_begin, pair_cdr(clause), scope);
+    }
+    if (pairp(pair_cdr(clause)) && pair_cadr(clause) == symbol_arrow) {
+        return cond_arrow(frame, scope);
+    }
+    if (nullp(pair_cdr(clause)) && nullp(pair_cdr(expr))) {
+        return analyze_sub(frame, pair_car(clause), scope);
+    }
+
+    // [expr, node, scope]
+    frame = frame_extend(frame, 3, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    *frame_ref(frame, 2) = scope;
+    if (nullp(pair_cdr(clause))) {
+        // (test) yields the value of the test, if true.
+        node = node_wrap(frame, ND_OR, 2);
+        *frame_ref(frame, 1) = node;
+        node_set(node, 0, analyze_sub(frame, pair_car(clause), scope));
+        node_set(node, 1, analyze_rest(frame, lang_cond, pair_cdr(expr),
+                                       scope));
+        return node;
+    }
+    node = node_wrap(frame, ND_IF, 3);
+    *frame_ref(frame, 1) = node;
+    node_set(node, 0, analyze_sub(frame, pair_car(clause), scope));
+    node_set(node, 1, analyze_rest(frame, lang_begin, pair_cdr(clause),
+                                   scope));
+    node_set(node, 2, analyze_rest(frame, lang_cond, pair_cdr(expr), scope));
+    return node;
+}
+
+// (case key ((datum ...) expr ...) ... (else expr ...)), the datums are
+// compared to the key with eq?.
+static obj_t *
+lang_case(obj_t **frame, obj_t *scope)
+{
+    obj_t *expr = *frame_ref(frame, 0);
+    obj_t *node, *clause, *datums, *iter;
+    long len = 0;
+    long i;
+
+    if (!pairp(expr)) {
+        fatal_error("case -- missing key", frame);
+    }
+    for (iter = pair_cdr(expr); pairp(iter); iter = pair_cdr(iter), ++len) {
+        clause = pair_car(iter);
+        if (!pairp(clause)) {
+            fatal_error("case -- malformed clause", frame);
+        }
+        if (pair_car(clause) == symbol_else) {
+            if (!nullp(pair_cdr(iter))) {
+                fatal_error("case -- else is not the last clause", frame);
             }
+            continue;
+        }
+        datums = pair_car(clause);
+        while (pairp(datums)) {
+            datums = pair_cdr(datums);
+        }
+        if (!nullp(datums)) {
+            fatal_error("case -- malformed datums", frame);
+        }
+    }
+    if (!nullp(iter)) {
+        fatal_error("case -- not a well-formed list", frame);
+    }
+
+    // [expr, node, scope]
+    frame = frame_extend(frame, 3, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    *frame_ref(frame, 2) = scope;
+    node = node_wrap(frame, ND_CASE, 1 + 2 * len);
+    *frame_ref(frame, 1) = node;
+
+    node_set(node, 0, analyze_sub(frame, pair_car(expr), scope));
+    for (i = 0, iter = pair_cdr(expr); i < len; ++i, iter = pair_cdr(iter)) {
+        clause = pair_car(iter);
+        if (pair_car(clause) == symbol_else) {
+            node_set(node, 1 + 2 * i, boolean_wrap(1));
         }
-        if (flag)
-            *flag = QQ_DEFAULT;
-        return pair_cdr(content);
+        else {
+            node_set(node, 1 + 2 * i, pair_car(clause));
+        }
+        node_set(node, 2 + 2 * i, analyze_rest(frame, lang_begin,
+                                               pair_cdr(clause), scope));
     }
+    return node;
 }
 
+// (and a b ...) is (if a (and b ...) #f)
 static obj_t *
-lang_quasiquote(obj_t **frame, obj_t **tailp)
+lang_and(obj_t **frame, obj_t *scope)
 {
     obj_t *expr = *frame_ref(frame, 0);
-    obj_t *content;
-    *tailp = NULL;
-    if (nullp(expr) || !nullp(pair_cdr(expr))) {
-        fatal_error("quasiquote -- wrong number of argument", frame);
+    obj_t *node;
+
+    if (nullp(expr)) {
+        return analyze_sub(frame, boolean_wrap(1), scope);
+    }
+    if (!pairp(expr)) {
+        fatal_error("and -- not a well-formed list", frame);
     }
+    if (nullp(pair_cdr(expr))) {
+        return analyze_sub(frame, pair_car(expr), scope);
+    }
+
+    // [expr, node, scope]
+    frame = frame_extend(frame, 3, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    *frame_ref(frame, 2) = scope;
+    node = node_wrap(frame, ND_IF, 3);
+    *frame_ref(frame, 1) = node;
 
-    // Expand...
-    content = pair_car(expr);
-    return expand_quasiquote(frame, content, NULL);
+    node_set(node, 0, analyze_sub(frame, pair_car(expr), scope));
+    node_set(node, 1, analyze_rest(frame, lang_and, pair_cdr(expr), scope));
+    node_set(node, 2, analyze_sub(frame, boolean_wrap(0), scope));
+    return node;
 }
 
 static obj_t *
-lang_lambda_syntax(obj_t **frame, obj_t **tailp)
+lang_or(obj_t **frame, obj_t *scope)
 {
     obj_t *expr = *frame_ref(frame, 0);
-    obj_t *clos;
-    *tailp = NULL;
+    obj_t *node, *iter;
+    long len = 0;
+    long i;
 
-    // LOL!!!
-    clos = closure_wrap(frame, frame_env(frame),
-                        pair_car(expr), pair_cdr(expr));
-    SGC_ROOT1(frame, clos);
-    return macro_wrap(frame, clos);
+    for (iter = expr; pairp(iter); iter = pair_cdr(iter)) {
+        ++len;
+    }
+    if (!nullp(iter)) {
+        fatal_error("or -- not a well-formed list", frame);
+    }
+    if (len == 0) {
+        return analyze_sub(frame, boolean_wrap(0), scope);
+    }
+    if (len == 1) {
+        return analyze_sub(frame, pair_car(expr), scope);
+    }
+
+    // [expr, node, scope]
+    frame = frame_extend(frame, 3, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    *frame_ref(frame, 2) = scope;
+    node = node_wrap(frame, ND_OR, len);
+    *frame_ref(frame, 1) = node;
+
+    for (i = 0, iter = expr; i < len; ++i, iter = pair_cdr(iter)) {
+        node_set(node, i, analyze_sub(frame, pair_car(iter), scope));
+    }
+    return node;
+}
+
+// (when test expr ...) and (unless test expr ...) are ifs whose body is
+// at the given branch, the other one yields unspec.
+static obj_t *
+make_when(obj_t **frame, obj_t *scope, long branch, const char *msg)
+{
+    obj_t *expr = *frame_ref(frame, 0);
+    obj_t *node;
+
+    if (!pairp(expr)) {
+        fatal_error(msg, frame);
+    }
+
+    // [expr, node, scope]
+    frame = frame_extend(frame, 3, FR_CLEAR_SLOTS | FR_SAVE_PREV |
+                                   FR_CONTINUE_ENV);
+    *frame_ref(frame, 0) = expr;
+    *frame_ref(frame, 2) = scope;
+    node = node_wrap(frame, ND_IF, 3);
+    *frame_ref(frame, 1) = node;
+
+    node_set(node, 0, analyze_sub(frame, pair_car(expr), scope));
+    node_set(node, branch, analyze_rest(frame, lang_begin, pair_cdr(expr),
+                                        scope));
+    node_set(node, 3 - branch, analyze_sub(frame, unspec_wrap(), scope));
+    return node;
 }
 
+static obj_t *
+lang_when(obj_t **frame, obj_t *scope)
+{
+    return make_when(frame, scope, 1, "when -- missing test");
+}
 
+static obj_t *
+lang_unless(obj_t **frame, obj_t *scope)
+{
+    return make_when(frame, scope, 2, "unless -- missing test");
+}
@@ -6,8 +6,33 @@
 // Load all the special forms, will shut down gc for a while.
 void slang_open(obj_t *env);
 
-// Shall the return value be evaluated again?
-bool_t slang_tailp(obj_t *val);
+// Analyse the expression on frame_ref(frame, 0) into a node tree.
+// Scope is the enclosing ND_LAMBDA node or nil for the toplevel.
+obj_t *slang_analyze(obj_t **frame, obj_t *scope);
+
+// Lambda bodies are analysed lazily, on their first application.
+void slang_analyze_lambda(obj_t **frame, obj_t *lambda);
+bool_t slang_lambda_analyzedp(obj_t *lambda);
+obj_t *slang_lambda_body(obj_t *lambda);
+obj_t *slang_lambda_formals(obj_t *lambda);
+// Number of slots in the env of an application, once analysed.
+size_t slang_lambda_nb_slots(obj_t *lambda);
+// Whether the env of an application may be captured by inner lambdas.
+// If not, it can live on the stack.
+bool_t slang_lambda_capturedp(obj_t *lambda);
+
+// Macro expansions are kept in the analysed lambdas. Rebinding a macro
+// or binding a new one bumps the epoch, then lambdas compiled before
+// should be checked for stale expansions, or calls to names which are
+// now macros, and reset to be analysed again. The env is the one of
+// the closure.
+extern long slang_macro_epoch;
+void slang_note_rebind(obj_t *old_value, obj_t *new_value);
+bool_t slang_lambda_stalep(obj_t *env, obj_t *lambda);
+void slang_lambda_reset(obj_t **frame, obj_t *lambda);
+// The code object compiled for the lambda, or nil.
+obj_t *slang_lambda_code(obj_t *lambda);
+void slang_lambda_set_code(obj_t *lambda, obj_t *code);
 
 
 #endif /* SLANG_H */
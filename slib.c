@@ -64,6 +64,8 @@ static obj_t *lib_rtinfo(obj_t **frame);
 static obj_t *lib_set_backtrace_base(obj_t **frame);
 static obj_t *lib_dogc(obj_t **frame);
 static obj_t *lib_gc_set_verbosity(obj_t **frame);
+static obj_t *lib_gc_set_pause_budget(obj_t **frame);
+static obj_t *lib_gc_set_threads(obj_t **frame);
 static obj_t *lib_error(obj_t **frame);
 static obj_t *lib_eval(obj_t **frame);
 static obj_t *lib_apply(obj_t **frame);
@@ -71,6 +73,7 @@ static obj_t *lib_null_environ(obj_t **frame);
 static obj_t *lib_report_environ(obj_t **frame);
 
 static obj_t *lib_call_ec(obj_t **frame);
+static obj_t *lib_call_cc(obj_t **frame);
 
 static obj_t *lib_load(obj_t **frame);
 
@@ -134,6 +137,8 @@ static procdef_t library[] = {
     // Runtime Reflection
     {"gc", lib_dogc},
     {"gc-set-verbosity", lib_gc_set_verbosity},
+    {"gc-set-pause-budget", lib_gc_set_pause_budget},
+    {"gc-set-threads", lib_gc_set_threads},
     {"runtime-info", lib_rtinfo},
     {"set-backtrace-base", lib_set_backtrace_base},
     {"error", lib_error},
@@ -146,6 +151,7 @@ static procdef_t library[] = {
 
     // Fancy stuffs
     {"call-with-escaping-continuation", lib_call_ec},
+    {"call-with-current-continuation", lib_call_cc},
 
     // Extension
     {"load", lib_load},
@@ -160,16 +166,39 @@ static procdef_t library[] = {
     {NULL, NULL}
 };
 
+// In the order of enum lib_prim.
+static struct {
+    const char *name;
+    sobj_funcptr_t func;
+    long argc;
+    obj_t *symbol;  // interned by slib_open()
+} prims[NB_LIB_PRIMS] = {
+    {"car", lib_car, 1},
+    {"cdr", lib_cdr, 1},
+    {"cons", lib_cons, 2},
+    {"+", lib_add, 2},
+    {"-", lib_minus, 2},
+    {"<", lib_lessthan, 2},
+    {"eq?", lib_eqp, 2},
+    {"null?", lib_nullp, 1},
+    {"pair?", lib_pairp, 1},
+    {"vector-ref", lib_vector_ref, 2}
+};
+
 void
 slib_open(obj_t *env)
 {
     obj_t *binding;
     procdef_t *iter;
+    long prim;
     gc_set_enabled(0);
     for (iter = library; iter->name; ++iter) {
         environ_bind(NULL, env, symbol_intern(NULL, iter->name),
                      proc_wrap(NULL, iter->func));
     }
+    for (prim = 0; prim < NB_LIB_PRIMS; ++prim) {
+        prims[prim].symbol = symbol_intern(NULL, prims[prim].name);
+    }
     gc_set_enabled(1);
 }
 
@@ -185,6 +214,42 @@ lib_is_apply_proc(obj_t *proc)
     return proc->as_proc.func == lib_apply;
 }
 
+bool_t
+lib_is_call_ec_proc(obj_t *proc)
+{
+    return proc->as_proc.func == lib_call_ec;
+}
+
+bool_t
+lib_is_call_cc_proc(obj_t *proc)
+{
+    return proc->as_proc.func == lib_call_cc;
+}
+
+bool_t
+lib_is_load_proc(obj_t *proc)
+{
+    return proc->as_proc.func == lib_load;
+}
+
+obj_t *
+lib_prim_symbol(enum lib_prim prim)
+{
+    return prims[prim].symbol;
+}
+
+long
+lib_prim_argc(enum lib_prim prim)
+{
+    return prims[prim].argc;
+}
+
+bool_t
+lib_is_prim_proc(obj_t *proc, enum lib_prim prim)
+{
+    return procedurep(proc) && proc->as_proc.func == prims[prim].func;
+}
+
 static
 void execute_expr_list(obj_t **frame, obj_t *prog)
 {
@@ -459,7 +524,7 @@ lib_vector_set(obj_t **frame)
         vec = *frame_ref(frame, 2);
         idx = fixnum_unwrap(*frame_ref(frame, 1));
         val = *frame_ref(frame, 0);
-        *vector_ref(vec, idx) = val;
+        vector_set(vec, idx, val);
         return unspec_wrap();
     }
     else {
@@ -814,6 +879,40 @@ lib_gc_set_verbosity(obj_t **frame)
     }
 }
 
+static obj_t *
+lib_gc_set_pause_budget(obj_t **frame)
+{
+    LIB_PROC_HEADER();
+    if (argc == 1) {
+        obj_t *usec = *frame_ref(frame, 0);
+        if (!fixnump(usec) || fixnum_unwrap(usec) < 0)
+            fatal_error("gc-set-pause-budget require a non-negative "
+                        "integer argument", frame);
+        gc_set_pause_budget(fixnum_unwrap(usec));
+        return unspec_wrap();
+    }
+    else {
+        fatal_error("gc-set-pause-budget require 1 argument", frame);
+    }
+}
+
+static obj_t *
+lib_gc_set_threads(obj_t **frame)
+{
+    LIB_PROC_HEADER();
+    if (argc == 1) {
+        obj_t *n = *frame_ref(frame, 0);
+        if (!fixnump(n) || fixnum_unwrap(n) < 1)
+            fatal_error("gc-set-threads require a positive integer "
+                        "argument", frame);
+        gc_set_nb_threads(fixnum_unwrap(n));
+        return unspec_wrap();
+    }
+    else {
+        fatal_error("gc-set-threads require 1 argument", frame);
+    }
+}
+
 static obj_t *
 lib_error(obj_t **frame)
 {
@@ -888,6 +987,13 @@ lib_apply(obj_t **frame)
     fatal_error("apply is never called directly", frame);
 }
 
+static obj_t *
+lib_call_cc(obj_t **frame)
+{
+    fatal_error("call-with-current-continuation is never called directly",
+                frame);
+}
+
 static obj_t *
 lib_null_environ(obj_t **frame)
 {
@@ -952,35 +1058,8 @@ lib_load(obj_t **frame)
 static obj_t *
 lib_call_ec(obj_t **frame)
 {
-    LIB_PROC_HEADER();
-    if (argc == 1) {
-        jmp_buf env;
-        obj_t *proc = *frame_ref(frame, 0);
-        obj_t *cont = econt_wrap(frame, &env);
-        obj_t *arg = pair_wrap(frame, cont, nil_wrap());
-        obj_t *expr = pair_wrap(frame, proc, arg);
-        obj_t *retval;
-
-        if (!setjmp(env)) {
-            // Enter the proc
-            obj_t **ex_frame = frame_extend(frame, 1,
-                    FR_SAVE_PREV | FR_CONTINUE_ENV);
-            *frame_ref(ex_frame, 0) = expr;
-            // May not return.
-            retval = eval_frame(ex_frame);
-        }
-        else {
-            // Escape from the proc
-            retval = econt_getaux(cont);
-        }
-        // Clear up the continuation
-        econt_clear(cont);
-        return retval;
-    }
-    else {
-        fatal_error("call-with-escaping-continuation "
-                    "require 1 argument", frame);
-    }
+    fatal_error("call-with-escaping-continuation is never called directly",
+                frame);
 }
 
 // Used in read and readline-set-prompt
@@ -7,6 +7,30 @@
 void slib_open(obj_t *env);
 bool_t lib_is_eval_proc(obj_t *proc);
 bool_t lib_is_apply_proc(obj_t *proc);
+bool_t lib_is_call_ec_proc(obj_t *proc);
+bool_t lib_is_call_cc_proc(obj_t *proc);
+bool_t lib_is_load_proc(obj_t *proc);
+
+// Primitives which the compiler runs inline, as long as their global
+// binding holds the library procedure. @see OP_PRIM
+enum lib_prim {
+    LP_CAR,
+    LP_CDR,
+    LP_CONS,
+    LP_ADD,
+    LP_MINUS,
+    LP_LESSTHAN,
+    LP_EQP,
+    LP_NULLP,
+    LP_PAIRP,
+    LP_VECTOR_REF,
+    NB_LIB_PRIMS
+};
+// The interned name of the primitive.
+obj_t *lib_prim_symbol(enum lib_prim prim);
+// Only the calls with this number of arguments are inlined.
+long lib_prim_argc(enum lib_prim prim);
+bool_t lib_is_prim_proc(obj_t *proc, enum lib_prim prim);
 
 void slib_primitive_load(obj_t **frame, const char *file_name);
 void slib_primitive_load_string(obj_t **frame, const char *expr_str);
@@ -8,11 +8,6 @@
 // Uncomment this when testing collector.
 //#define ALWAYS_COLLECT
 
-static header_obj_t w_nil;
-static header_obj_t w_true;
-static header_obj_t w_false;
-static header_obj_t w_unspec;
-static header_obj_t w_eofobj;
 static obj_t *symbol_table = NULL;
 
 static obj_t *default_gc_visitor(obj_t *self);
@@ -23,7 +18,10 @@ static obj_t *vector_gc_visitor(obj_t *self);
 static obj_t *environ_gc_visitor(obj_t *self);
 static obj_t *dict_gc_visitor(obj_t *self);
 static obj_t *macro_gc_visitor(obj_t *self);
-static obj_t *econt_gc_visitor(obj_t *self);
+static obj_t *cont_gc_visitor(obj_t *self);
+static obj_t *node_gc_visitor(obj_t *self);
+static obj_t *code_gc_visitor(obj_t *self);
+static void code_gc_finalizer(obj_t *self);
 
 // Initialize gc visitors and finalizers for each primitive type.
 void
@@ -35,12 +33,6 @@ sobj_init()
 
     initialized = 1;
 
-    w_nil.ob_type = TP_NIL;
-    w_true.ob_type = TP_BOOLEAN;
-    w_false.ob_type = TP_BOOLEAN;
-    w_unspec.ob_type = TP_UNSPECIFIED;
-    w_eofobj.ob_type = TP_EOFOBJ;
-
     gc_register_type(TP_PAIR, pair_gc_visitor, default_gc_finalizer);
     gc_register_type(TP_SYMBOL, default_gc_visitor, default_gc_finalizer);
     gc_register_type(TP_PROC, default_gc_visitor, default_gc_finalizer);
@@ -57,8 +49,11 @@ sobj_init()
     gc_register_type(TP_DICT, dict_gc_visitor, default_gc_finalizer);
     gc_register_type(TP_SPECFORM, default_gc_visitor, default_gc_finalizer);
     gc_register_type(TP_MACRO, macro_gc_visitor, default_gc_finalizer);
-    gc_register_type(TP_ECONT, econt_gc_visitor, default_gc_finalizer);
+    gc_register_type(TP_ECONT, default_gc_visitor, default_gc_finalizer);
     gc_register_type(TP_UDATA, default_gc_visitor, default_gc_finalizer);
+    gc_register_type(TP_NODE, node_gc_visitor, default_gc_finalizer);
+    gc_register_type(TP_CODE, code_gc_visitor, code_gc_finalizer);
+    gc_register_type(TP_CONT, cont_gc_visitor, default_gc_finalizer);
 
     // Symbol table
     sgc_init();
@@ -70,7 +65,13 @@ sobj_init()
 type_t
 get_type(obj_t *self)
 {
-    return self->ob_type;
+    uintptr_t bits = (uintptr_t)self;
+    if (bits & IMM_FIXNUM_TAG)
+        return TP_FIXNUM;
+    else if (bits & IMM_CONST_TAG)
+        return (bits >> 2) & 0xff;
+    else
+        return self->ob_type;
 }
 
 const char *
@@ -92,13 +93,16 @@ get_typename(obj_t *self)
         case TP_ECONT: return "escape-continuation";
         case TP_UDATA: return "udata";
         case TP_EOFOBJ: return "eof";
+        case TP_NODE: return "node";
+        case TP_CODE: return "code";
+        case TP_CONT: return "continuation";
     }
     NOT_REACHED();
 }
 
 bool_t to_boolean(obj_t *self)
 {
-    if (self == (obj_t *)&w_false)
+    if (self == boolean_wrap(0))
         return 0;
     else
         return 1;
@@ -187,8 +191,8 @@ print_repr(obj_t *self, FILE *stream)
 
     case TP_ENVIRON:
         fprintf(stream, "#<environ at %p", self);
-        if (!nullp(self->as_environ.cdr)) {
-            fprintf(stream, " outer=%p", self->as_environ.cdr);
+        if (!nullp(self->as_environ.outer)) {
+            fprintf(stream, " outer=%p", self->as_environ.outer);
         }
         fprintf(stream, ">");
         break;
@@ -215,7 +219,21 @@ print_repr(obj_t *self, FILE *stream)
         break;
 
     case TP_ECONT:
-        fprintf(stream, "#<escape-continuation at %p>", self->as_econt.env);
+        fprintf(stream, "#<escape-continuation at %p>",
+                self->as_econt.frame);
+        break;
+
+    case TP_CONT:
+        fprintf(stream, "#<continuation at %p>", self);
+        break;
+
+    case TP_NODE:
+        fprintf(stream, "#<node kind=%d at %p>", node_kind(self), self);
+        break;
+
+    case TP_CODE:
+        fprintf(stream, "#<code (%ld insns) at %p>",
+                code_length(self), self);
         break;
 
     default:
@@ -266,6 +284,9 @@ generic_hash(obj_t *self)
     case TP_ECONT:
     case TP_UDATA:
     case TP_EOFOBJ:
+    case TP_NODE:
+    case TP_CODE:
+    case TP_CONT:
         hval = (long)self;
         break;
     default:
@@ -298,6 +319,9 @@ generic_eq(obj_t *a, obj_t *b)
     case TP_MACRO:
     case TP_ECONT:
     case TP_UDATA:
+    case TP_NODE:
+    case TP_CODE:
+    case TP_CONT:
         return 0;
 
     case TP_FIXNUM:
@@ -405,31 +429,34 @@ fatal_error(const char *msg, obj_t **frame)
 obj_t *
 nil_wrap()
 {
-    return (obj_t *)&w_nil;
+    return IMM_CONST(TP_NIL, 0);
 }
 
 obj_t *
 boolean_wrap(bool_t bval)
 {
-    return (obj_t *)(bval ? &w_true : &w_false);
+    return IMM_CONST(TP_BOOLEAN, bval ? 1 : 0);
 }
 
 obj_t *
 unspec_wrap()
 {
-    return (obj_t *)&w_unspec;
+    return IMM_CONST(TP_UNSPECIFIED, 0);
 }
 
 obj_t *
 eofobj_wrap()
 {
-    return (obj_t *)&w_eofobj;
+    return IMM_CONST(TP_EOFOBJ, 0);
 }
 
 // Fixnum
 obj_t *
 fixnum_wrap(obj_t **frame, long ival)
 {
+    if (ival >= FIXNUM_MIN && ival <= FIXNUM_MAX)
+        return (obj_t *)(((uintptr_t)ival << 1) | IMM_FIXNUM_TAG);
+
 #ifdef ALWAYS_COLLECT
     gc_collect(frame);
 #endif
@@ -447,7 +474,9 @@ fixnum_wrap(obj_t **frame, long ival)
 long
 fixnum_unwrap(obj_t *self)
 {
-    if (fixnump(self))
+    if ((uintptr_t)self & IMM_FIXNUM_TAG)
+        return (intptr_t)self >> 1;
+    else if (fixnump(self))
         return self->as_fixnum.val;
     else
         fatal_error("not a fixnum", NULL);
@@ -530,6 +559,33 @@ pair_copy_list(obj_t **frame, obj_t *self)
     return cpy;
 }
 
+obj_t *
+pair_append(obj_t **frame, obj_t *self, obj_t *tail)
+{
+    obj_t *iter, *cpy, *dest;
+
+    // Checked before allocating, so that a bad list allocates nothing.
+    iter = self;
+    while (pairp(iter)) {
+        iter = pair_cdr(iter);
+    }
+    if (!nullp(iter)) {
+        fatal_error("pair_append: not a well-formed list", frame);
+    }
+    if (nullp(self)) {
+        return tail;
+    }
+
+    SGC_ROOT2(frame, self, tail);
+    cpy = pair_wrap(frame, pair_car(self), tail);
+    SGC_ROOT1(frame, cpy);
+    for (dest = cpy, iter = pair_cdr(self); pairp(iter);
+            dest = pair_cdr(dest), iter = pair_cdr(iter)) {
+        pair_set_cdr(dest, pair_wrap(frame, pair_car(iter), tail));
+    }
+    return cpy;
+}
+
 obj_t *
 pair_car(obj_t *self)
 {
@@ -551,8 +607,10 @@ pair_cdr(obj_t *self)
 void
 pair_set_car(obj_t *self, obj_t *car)
 {
-    if (pairp(self))
+    if (pairp(self)) {
         self->as_pair.car = car;
+        SGC_WRITE_BARRIER(self, car);
+    }
     else
         fatal_error("not a pair", NULL);
 }
@@ -560,14 +618,16 @@ pair_set_car(obj_t *self, obj_t *car)
 void
 pair_set_cdr(obj_t *self, obj_t *cdr)
 {
-    if (pairp(self))
+    if (pairp(self)) {
         self->as_pair.cdr = cdr;
+        SGC_WRITE_BARRIER(self, cdr);
+    }
     else
         fatal_error("not a pair", NULL);
 }
 
 // Symbol
-static obj_t *
+obj_t *
 symbol_wrap(obj_t **frame, const char *sval)
 {
 #ifdef ALWAYS_COLLECT
@@ -612,7 +672,11 @@ long
 symbol_hash(obj_t *self)
 {
     const char *sval;
-    long hash = self->as_symbol.hash;
+    long hash;
+    // Dicts hash their keys through here, so immediates reach it too.
+    if (!symbolp(self))
+        fatal_error("not a symbol", NULL);
+    hash = self->as_symbol.hash;
     if (hash == -1) {
         sval = symbol_unwrap(self);
         hash = string_hash(sval, strlen(sval));
@@ -777,6 +841,13 @@ closure_body(obj_t *self)
         fatal_error("not a closure", NULL);
 }
 
+void
+closure_set_body(obj_t *self, obj_t *body)
+{
+    self->as_closure.body = body;
+    SGC_WRITE_BARRIER(self, body);
+}
+
 obj_t *
 vector_wrap(obj_t **frame, size_t nb_alloc, obj_t *fill)
 {
@@ -823,7 +894,7 @@ vector_from_list(obj_t **frame, obj_t *lis)
     obj_t *self = vector_wrap(frame, list_len, nil_wrap());
     size_t i = 0;
     for (; i < list_len; ++i, lis = pair_cdr(lis)) {
-        *vector_ref(self, i) = pair_car(lis);
+        vector_set(self, i, pair_car(lis));
     }
     return self;
 }
@@ -835,6 +906,13 @@ vector_ref(obj_t *self, long index)
     return self->as_vector.data + index;
 }
 
+void
+vector_set(obj_t *self, long index, obj_t *value)
+{
+    self->as_vector.data[index] = value;
+    SGC_WRITE_BARRIER(self, value);
+}
+
 size_t
 vector_length(obj_t *self)
 {
@@ -855,33 +933,66 @@ vector_to_list(obj_t **frame, obj_t *self)
 }
 
 // Accessor macros for environ
-#define ENV_CAR(self) (self->as_environ.car)
-#define ENV_CDR(self) (self->as_environ.cdr)
+#define ENV_OUTER(self) (self->as_environ.outer)
+#define ENV_DICT(self) (self->as_environ.dict)
 
 obj_t *
 environ_wrap(obj_t **frame, obj_t *outer)
+{
+    obj_t *self = environ_wrap_slots(frame, outer, 0);
+    SGC_ROOT1(frame, self);
+    ENV_DICT(self) = dict_wrap(frame);
+    SGC_WRITE_BARRIER(self, ENV_DICT(self));
+    return self;
+}
+
+obj_t *
+environ_wrap_slots(obj_t **frame, obj_t *outer, size_t nb_slots)
 {
 #ifdef ALWAYS_COLLECT
     SGC_ROOT1(frame, outer);
     gc_collect(frame);
 #endif
-    obj_t *self = gc_malloc(sizeof(environ_obj_t), TP_ENVIRON);
+    obj_t *self;
+    size_t i;
+    self = gc_malloc(sizeof(environ_obj_t) +
+                     sizeof(obj_t *) * nb_slots, TP_ENVIRON);
     if (!self) {
         SGC_ROOT1(frame, outer);
         gc_collect(frame);
-        self = gc_malloc(sizeof(environ_obj_t), TP_ENVIRON);
+        self = gc_malloc(sizeof(environ_obj_t) +
+                         sizeof(obj_t *) * nb_slots, TP_ENVIRON);
         if (!self)
             fatal_error("out of memory", frame);
     }
-    SGC_ROOT2(frame, self, outer);
-    ENV_CAR(self) = NULL;
-    ENV_CDR(self) = NULL;
-
-    ENV_CAR(self) = dict_wrap(frame);
-    ENV_CDR(self) = outer;
+    ENV_OUTER(self) = outer;
+    ENV_DICT(self) = NULL;
+    self->as_environ.nb_slots = nb_slots;
+    for (i = 0; i < nb_slots; ++i) {
+        self->as_environ.slots[i] = NULL;
+    }
     return self;
 }
 
+obj_t *
+environ_outer(obj_t *self)
+{
+    return ENV_OUTER(self);
+}
+
+obj_t **
+environ_ref(obj_t *self, long index)
+{
+    return self->as_environ.slots + index;
+}
+
+void
+environ_set_slot(obj_t *self, long index, obj_t *value)
+{
+    self->as_environ.slots[index] = value;
+    SGC_WRITE_BARRIER(self, value);
+}
+
 obj_t *
 environ_set(obj_t *self, obj_t *key, obj_t *value)
 {
@@ -901,12 +1012,14 @@ environ_lookup(obj_t *self, obj_t *key, enum environ_lookup_flag flag)
     obj_t *binding;
 
     while (!nullp(self)) {
-        binding = dict_lookup(NULL, ENV_CAR(self), key, DL_DEFAULT);
-        if (binding)
-            return binding;
+        if (ENV_DICT(self)) {
+            binding = dict_lookup(NULL, ENV_DICT(self), key, DL_DEFAULT);
+            if (binding)
+                return binding;
+        }
 
         if (flag == EL_LOOK_OUTER) {
-            self = ENV_CDR(self);
+            self = ENV_OUTER(self);
         }
         else {
             break;
@@ -928,13 +1041,20 @@ environ_def(obj_t **frame, obj_t *self, obj_t *key, obj_t *value)
     return binding;
 }
 
+long environ_version = 0;
+
 obj_t *
 environ_bind(obj_t **frame, obj_t *self, obj_t *key, obj_t *value)
 {
     obj_t *binding;
 
-    SGC_ROOT1(frame, value);
-    binding = dict_lookup(frame, ENV_CAR(self), key, DL_CREATE_ON_ABSENT);
+    ++environ_version;
+    SGC_ROOT3(frame, self, key, value);
+    if (!ENV_DICT(self)) {
+        ENV_DICT(self) = dict_wrap(frame);
+        SGC_WRITE_BARRIER(self, ENV_DICT(self));
+    }
+    binding = dict_lookup(frame, ENV_DICT(self), key, DL_CREATE_ON_ABSENT);
     pair_set_cdr(binding, value);
 
     return binding;
@@ -960,6 +1080,7 @@ dict_wrap(obj_t **frame)
     self->as_dict.hash_mask = DICT_INIT_SIZE - 1;
     self->as_dict.vec = NULL;
     self->as_dict.vec = vector_wrap(frame, DICT_INIT_SIZE, nil_wrap());
+    SGC_WRITE_BARRIER(self, self->as_dict.vec);
     return self;
 }
 
@@ -996,7 +1117,9 @@ dict_rehash(obj_t **frame, obj_t *self, size_t target_size)
     // may be represented as errors..
     ndict->as_dict.nb_items = self->as_dict.nb_items;
     ndict->as_dict.hash_mask = self->as_dict.hash_mask;
+    ndict->as_dict.vec = NULL;
     ndict->as_dict.vec = vector_wrap(frame, target_size, nil_wrap());
+    SGC_WRITE_BARRIER(ndict, ndict->as_dict.vec);
     // Other fields are not important
 
     // Then rehash each item in the self.
@@ -1020,9 +1143,11 @@ dict_rehash(obj_t **frame, obj_t *self, size_t target_size)
 
             new_entry_head = vector_ref(new_vec, new_bucket);
             *new_entry_head = pair_wrap(frame, entry, *new_entry_head);
+            SGC_WRITE_BARRIER(new_vec, *new_entry_head);
         }
     }
     self->as_dict.vec = new_vec;
+    SGC_WRITE_BARRIER(self, new_vec);
     self->as_dict.hash_mask = hash_mask;
 }
 
@@ -1058,6 +1183,7 @@ dict_lookup(obj_t **frame, obj_t *self, obj_t *key, enum dict_lookup_flag fl)
         entry_list = *entry_ref;
         entry = pair_wrap(frame, key, nil_wrap());
         *entry_ref = pair_wrap(frame, entry, entry_list);
+        SGC_WRITE_BARRIER(self->as_dict.vec, *entry_ref);
 
         self->as_dict.nb_items += 1;
         // :: Insert code here to rehash and expand the vector.
@@ -1079,6 +1205,7 @@ found_entry:
         else {
             // The found entry is the first entry.
             *entry_ref = pair_cdr(entry_list);
+            SGC_WRITE_BARRIER(self->as_dict.vec, *entry_ref);
         }
         self->as_dict.nb_items -= 1;
         // :: Insert code here to rehash and shrink the vector.
@@ -1205,7 +1332,7 @@ macro_expand(obj_t **frame, obj_t *self, obj_t *args)
 
 // Escape continuation
 obj_t *
-econt_wrap(obj_t **frame, void *env)
+econt_wrap(obj_t **frame, long activation)
 {
 #ifdef ALWAYS_COLLECT
     gc_collect(frame);
@@ -1217,15 +1344,15 @@ econt_wrap(obj_t **frame, void *env)
         if (!self)
             fatal_error("out of memory", frame);
     }
-    self->as_econt.env = env;
-    self->as_econt.aux = NULL;
+    self->as_econt.activation = activation;
+    self->as_econt.frame = NULL;
     return self;
 }
 
 bool_t
 continuationp(obj_t *self)
 {
-    return econtp(self);
+    return econtp(self) || contp(self);
 }
 
 bool_t
@@ -1234,28 +1361,312 @@ econtp(obj_t *self)
     return get_type(self) == TP_ECONT;
 }
 
-jmp_buf *
-econt_getenv(obj_t *self)
+long
+econt_activation(obj_t *self)
+{
+    return self->as_econt.activation;
+}
+
+obj_t **
+econt_frame(obj_t *self)
+{
+    return self->as_econt.frame;
+}
+
+void
+econt_set_frame(obj_t *self, obj_t **econt_frame)
+{
+    self->as_econt.frame = econt_frame;
+}
+
+// Full continuation
+obj_t *
+cont_wrap(obj_t **frame, obj_t **from, obj_t **to, long activation,
+          obj_t **cont_frame, long pc)
+{
+#ifdef ALWAYS_COLLECT
+    gc_collect(frame);
+#endif
+    size_t nb_words = to - from;
+    size_t size = sizeof(cont_obj_t) + sizeof(obj_t *) * nb_words;
+    obj_t *self = gc_malloc(size, TP_CONT);
+    if (!self) {
+        gc_collect(frame);
+        self = gc_malloc(size, TP_CONT);
+        if (!self)
+            fatal_error("out of memory", frame);
+    }
+    self->as_cont.activation = activation;
+    self->as_cont.frame = cont_frame;
+    self->as_cont.pc = pc;
+    self->as_cont.from = from;
+    self->as_cont.nb_words = nb_words;
+    memcpy(self->as_cont.words, from, nb_words * sizeof(obj_t *));
+    return self;
+}
+
+bool_t
+contp(obj_t *self)
+{
+    return get_type(self) == TP_CONT;
+}
+
+long
+cont_activation(obj_t *self)
+{
+    return self->as_cont.activation;
+}
+
+obj_t **
+cont_frame(obj_t *self)
+{
+    return self->as_cont.frame;
+}
+
+long
+cont_pc(obj_t *self)
+{
+    return self->as_cont.pc;
+}
+
+// Put the saved words back on the stack, and return where they start.
+obj_t **
+cont_restore(obj_t *self)
+{
+    memcpy(self->as_cont.from, self->as_cont.words,
+           self->as_cont.nb_words * sizeof(obj_t *));
+    return self->as_cont.from;
+}
+
+// Analysed expression node
+obj_t *
+node_wrap(obj_t **frame, enum node_kind kind, size_t nb_kids)
+{
+#ifdef ALWAYS_COLLECT
+    gc_collect(frame);
+#endif
+    obj_t *self;
+    size_t i;
+    self = gc_malloc(sizeof(node_obj_t) +
+                     sizeof(obj_t *) * nb_kids, TP_NODE);
+    if (!self) {
+        gc_collect(frame);
+        self = gc_malloc(sizeof(node_obj_t) +
+                         sizeof(obj_t *) * nb_kids, TP_NODE);
+        if (!self)
+            fatal_error("out of memory", frame);
+    }
+    self->as_node.kind = kind;
+    self->as_node.nb_kids = nb_kids;
+    self->as_node.ival = 0;
+    self->as_node.slot = 0;
+    for (i = 0; i < nb_kids; ++i) {
+        self->as_node.kids[i] = NULL;
+    }
+    return self;
+}
+
+bool_t
+nodep(obj_t *self)
+{
+    return get_type(self) == TP_NODE;
+}
+
+enum node_kind
+node_kind(obj_t *self)
+{
+    return self->as_node.kind;
+}
+
+void
+node_set_kind(obj_t *self, enum node_kind kind)
+{
+    self->as_node.kind = kind;
+}
+
+size_t
+node_length(obj_t *self)
+{
+    return self->as_node.nb_kids;
+}
+
+obj_t *
+node_ref(obj_t *self, long index)
+{
+    return self->as_node.kids[index];
+}
+
+void
+node_set(obj_t *self, long index, obj_t *kid)
+{
+    self->as_node.kids[index] = kid;
+    SGC_WRITE_BARRIER(self, kid);
+}
+
+long
+node_ival(obj_t *self)
+{
+    return self->as_node.ival;
+}
+
+void
+node_set_ival(obj_t *self, long ival)
+{
+    self->as_node.ival = ival;
+}
+
+long
+node_slot(obj_t *self)
 {
-    return (jmp_buf *)(self->as_econt.env);
+    return self->as_node.slot;
 }
 
 void
-econt_clear(obj_t *self)
+node_set_slot(obj_t *self, long slot)
+{
+    self->as_node.slot = slot;
+}
+
+// Code object
+obj_t *
+code_wrap(obj_t **frame, obj_t *lambda)
+{
+#ifdef ALWAYS_COLLECT
+    SGC_ROOT1(frame, lambda);
+    gc_collect(frame);
+#endif
+    obj_t *self = gc_malloc(sizeof(code_obj_t), TP_CODE);
+    if (!self) {
+        SGC_ROOT1(frame, lambda);
+        gc_collect(frame);
+        self = gc_malloc(sizeof(code_obj_t), TP_CODE);
+        if (!self)
+            fatal_error("out of memory", frame);
+    }
+    self->as_code.insns = NULL;
+    self->as_code.nb_insns = 0;
+    self->as_code.consts = nil_wrap();
+    self->as_code.lambda = lambda;
+    self->as_code.nb_slots = 0;
+    self->as_code.stack_env = 0;
+    self->as_code.defs_env = 0;
+    self->as_code.epoch = 0;
+    self->as_code.nb_args = 0;
+    self->as_code.vararg = 0;
+    return self;
+}
+
+bool_t
+codep(obj_t *self)
+{
+    return get_type(self) == TP_CODE;
+}
+
+bool_t
+code_compiledp(obj_t *self)
+{
+    return self->as_code.insns != NULL;
+}
+
+long *
+code_insns(obj_t *self)
+{
+    return self->as_code.insns;
+}
+
+size_t
+code_length(obj_t *self)
+{
+    return self->as_code.nb_insns;
+}
+
+obj_t *
+code_consts(obj_t *self)
 {
-    self->as_econt.env = NULL;
+    return self->as_code.consts;
 }
 
 obj_t *
-econt_getaux(obj_t *self)
+code_lambda(obj_t *self)
 {
-    return self->as_econt.aux;
+    return self->as_code.lambda;
 }
 
 void
-econt_putaux(obj_t *self, obj_t *thing)
+code_set_insns(obj_t *self, long *insns, size_t nb_insns, obj_t *consts)
 {
-    self->as_econt.aux = thing;
+    free(self->as_code.insns);
+    self->as_code.insns = insns;
+    self->as_code.nb_insns = nb_insns;
+    self->as_code.consts = consts;
+    SGC_WRITE_BARRIER(self, consts);
+}
+
+size_t
+code_nb_slots(obj_t *self)
+{
+    return self->as_code.nb_slots;
+}
+
+void
+code_set_nb_slots(obj_t *self, size_t nb_slots)
+{
+    self->as_code.nb_slots = nb_slots;
+}
+
+bool_t
+code_stack_envp(obj_t *self)
+{
+    return self->as_code.stack_env;
+}
+
+void
+code_set_stack_env(obj_t *self, bool_t stack_env)
+{
+    self->as_code.stack_env = stack_env;
+}
+
+bool_t
+code_defs_envp(obj_t *self)
+{
+    return self->as_code.defs_env;
+}
+
+void
+code_set_defs_env(obj_t *self, bool_t defs_env)
+{
+    self->as_code.defs_env = defs_env;
+}
+
+long
+code_epoch(obj_t *self)
+{
+    return self->as_code.epoch;
+}
+
+void
+code_set_epoch(obj_t *self, long epoch)
+{
+    self->as_code.epoch = epoch;
+}
+
+void
+code_set_arity(obj_t *self, long nb_args, bool_t vararg)
+{
+    self->as_code.nb_args = nb_args;
+    self->as_code.vararg = vararg;
+}
+
+long
+code_nb_args(obj_t *self)
+{
+    return self->as_code.nb_args;
+}
+
+bool_t
+code_varargp(obj_t *self)
+{
+    return self->as_code.vararg;
 }
 
 // Static utilities
@@ -1266,10 +1677,11 @@ default_gc_visitor(obj_t *self)
     return NULL;
 }
 
+// Finalizers release what the object owns, the collector releases the
+// object itself.
 static void
 default_gc_finalizer(obj_t *self)
 {
-    free(self);
 }
 
 static obj_t *
@@ -1300,8 +1712,12 @@ vector_gc_visitor(obj_t *self)
 static obj_t *
 environ_gc_visitor(obj_t *self)
 {
-    gc_mark(ENV_CAR(self));
-    return ENV_CDR(self);
+    size_t i;
+    gc_mark(ENV_DICT(self));
+    for (i = 0; i < self->as_environ.nb_slots; ++i) {
+        gc_mark(self->as_environ.slots[i]);
+    }
+    return ENV_OUTER(self);
 }
 
 static obj_t *
@@ -1317,8 +1733,36 @@ macro_gc_visitor(obj_t *self)
 }
 
 static obj_t *
-econt_gc_visitor(obj_t *self)
+cont_gc_visitor(obj_t *self)
 {
-    return self->as_econt.aux;
+    size_t i;
+    for (i = 0; i < self->as_cont.nb_words; ++i) {
+        // Saved frame pointers are not objects.
+        if (!sgc_framep(self->as_cont.words[i]))
+            gc_mark(self->as_cont.words[i]);
+    }
+    return NULL;
+}
+
+static obj_t *
+node_gc_visitor(obj_t *self)
+{
+    size_t i, len;
+    for (i = 0, len = node_length(self); i < len; ++i) {
+        gc_mark(node_ref(self, i));
+    }
+    return NULL;
 }
 
+static obj_t *
+code_gc_visitor(obj_t *self)
+{
+    gc_mark(code_consts(self));
+    return code_lambda(self);
+}
+
+static void
+code_gc_finalizer(obj_t *self)
+{
+    free(code_insns(self));
+}
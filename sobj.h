@@ -4,7 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
-#include <setjmp.h>
+#include <limits.h>
 
 // Simple debug macro
 // @see fatal_error
@@ -37,10 +37,27 @@ typedef uint8_t bool_t;
 #define TP_MACRO        16
 #define TP_ECONT        17
 #define TP_UDATA        18
-#define TP_MAX          TP_UDATA
+#define TP_NODE         19
+#define TP_CODE         20
+#define TP_CONT         21
+#define TP_MAX          TP_CONT
 
 typedef struct obj_t obj_t;
 
+// Immediates are encoded in the pointer itself and never allocated.
+// Fixnums have the lowest bit set and the rest as the value. Constants
+// (nil, booleans, etc.) have bit 1 set, then their type and value.
+#define IMM_FIXNUM_TAG  1
+#define IMM_CONST_TAG   2
+#define IMM_TAG_MASK    3
+#define IMM_CONST(type, val) \
+    ((obj_t *)(((uintptr_t)(val) << 10) | ((type) << 2) | IMM_CONST_TAG))
+#define immediatep(o) (((uintptr_t)(o) & IMM_TAG_MASK) != 0)
+
+// Fixnums out of this range are still heap-allocated.
+#define FIXNUM_MAX (LONG_MAX >> 1)
+#define FIXNUM_MIN (LONG_MIN >> 1)
+
 typedef struct {
     long val;
 } fixnum_obj_t;
@@ -66,8 +83,8 @@ typedef struct {
 
 // For primitive procedures
 typedef obj_t * (*sobj_funcptr_t) (obj_t **);
-// For special forms
-typedef obj_t * (*sobj_funcptr2_t) (obj_t **, obj_t **);
+// For special forms, which analyse their arguments into a node.
+typedef obj_t * (*sobj_funcptr2_t) (obj_t **, obj_t *);
 
 typedef struct {
     sobj_funcptr_t func;
@@ -84,7 +101,15 @@ typedef struct {
     obj_t *data[1];
 } vector_obj_t;
 
-typedef pair_obj_t environ_obj_t;
+// Closure applications keep their locals in slots, which are numbered
+// at analysis time. The dict holds named bindings and is only created
+// for the toplevel and eval'd envs, or lazily on a bind by name.
+typedef struct {
+    obj_t *outer;
+    obj_t *dict;
+    size_t nb_slots;
+    obj_t *slots[1];
+} environ_obj_t;
 
 typedef struct {
     uint32_t nb_items;
@@ -100,12 +125,47 @@ typedef struct {
     obj_t *rules;  // rule implemented as closure
 } macro_obj_t;
 
-// Escaping continuation
+// Escaping continuation, valid while the frame made for the proc of
+// call/ec is running, @see seval.c
 typedef struct {
-    void *env; 
-    obj_t *aux;
+    long activation;  // serial of the vm activation
+    obj_t **frame;
 } econt_obj_t;
 
+// Full continuation: a copy of the shadow stack between the call/cc
+// caller and the base frame of its vm activation, @see seval.c
+typedef struct {
+    long activation;  // serial of the vm activation
+    obj_t **frame;  // frame of the call/cc caller
+    long pc;  // resume offset in the caller's code, or -1 to return
+    obj_t **from;  // where the words are copied back
+    size_t nb_words;
+    obj_t *words[1];
+} cont_obj_t;
+
+// Pre-analysed expression, @see slang:slang_analyze()
+typedef struct {
+    uint32_t kind;
+    uint32_t nb_kids;
+    long ival;  // lexical depth for variable nodes
+    long slot;  // slot index for local variable nodes
+    obj_t *kids[1];
+} node_obj_t;
+
+// Compiled bytecode, @see scomp.c
+typedef struct {
+    long *insns;  // NULL until compiled
+    size_t nb_insns;
+    obj_t *consts;  // vector as the constant pool
+    obj_t *lambda;  // ND_LAMBDA node or nil for toplevel code
+    size_t nb_slots;  // size of the env created on each application
+    bool_t stack_env;  // the env is kept in slots on the stack instead
+    bool_t defs_env;  // with an env above it for runtime definitions
+    long epoch;  // macro epoch when last checked, @see slang.h
+    long nb_args;  // number of the fixed formals
+    bool_t vararg;  // the rest args are bound as a list after them
+} code_obj_t;
+
 // 16-byte for each object...
 #define OB_HEADER \
     obj_t * gc_next; \
@@ -135,6 +195,9 @@ struct obj_t {
         specform_obj_t as_specform;
         macro_obj_t as_macro;
         econt_obj_t as_econt;
+        cont_obj_t as_cont;
+        node_obj_t as_node;
+        code_obj_t as_code;
     };
 };
 
@@ -179,6 +242,8 @@ double flonum_unwrap(obj_t *self);
 obj_t *pair_wrap(obj_t **frame, obj_t *car, obj_t *cdr);
 bool_t pairp(obj_t *self);
 obj_t *pair_copy_list(obj_t **frame, obj_t *self);
+// A copy of the list whose last cdr is tail, or tail for an empty list.
+obj_t *pair_append(obj_t **frame, obj_t *self, obj_t *tail);
 obj_t *pair_car(obj_t *self);
 obj_t *pair_cdr(obj_t *self);
 void pair_set_car(obj_t *self, obj_t *car);
@@ -187,6 +252,8 @@ void pair_set_cdr(obj_t *self, obj_t *cdr);
 // Symbol
 bool_t symbolp(obj_t *self);
 obj_t *symbol_intern(obj_t **frame, const char *sval);
+// Not interned, so only eq? to itself.
+obj_t *symbol_wrap(obj_t **frame, const char *sval);
 const char *symbol_unwrap(obj_t *self);
 long symbol_hash(obj_t *self);
 bool_t symbol_eq(obj_t *self, obj_t *other);
@@ -209,12 +276,15 @@ bool_t closurep(obj_t *self);
 obj_t *closure_env(obj_t *self);
 obj_t *closure_formals(obj_t *self);
 obj_t *closure_body(obj_t *self);
+void closure_set_body(obj_t *self, obj_t *body);
 
 // Vector
 obj_t *vector_wrap(obj_t **frame, size_t nb_alloc, obj_t *fill);
 bool_t vectorp(obj_t *self);
 obj_t *vector_from_list(obj_t **frame, obj_t *lis);
 obj_t **vector_ref(obj_t *self, long index);
+// Stores into an object go through the setters for the write barrier.
+void vector_set(obj_t *self, long index, obj_t *value);
 size_t vector_length(obj_t *self);
 obj_t *vector_to_list(obj_t **frame, obj_t *self);
 
@@ -224,15 +294,24 @@ enum environ_lookup_flag {
     EL_LOOK_OUTER
 };
 // Implementation details:
-//   Currently the environment is implemented as a list.
-//   e.g., (env . outer-env)
-//   Where env is ((key . value) (key2 . value2) ...)
+//   An environment is a dict of (key . value) bindings or a fixed
+//   number of slots, plus the outer environment.
+//   Lookups by name skip the slots, which are only accessed by index.
 obj_t *environ_wrap(obj_t **frame, obj_t *outer);
+// Slots are initialized to NULL, meaning unbound.
+obj_t *environ_wrap_slots(obj_t **frame, obj_t *outer, size_t nb_slots);
 bool_t environp(obj_t *self);
+obj_t *environ_outer(obj_t *self);
+obj_t **environ_ref(obj_t *self, long index);
+void environ_set_slot(obj_t *self, long index, obj_t *value);
 obj_t *environ_set(obj_t *self, obj_t *key, obj_t *val);
 obj_t *environ_lookup(obj_t *self, obj_t *key, enum environ_lookup_flag);
 obj_t *environ_def(obj_t **frame, obj_t *self, obj_t *key, obj_t *value);
 obj_t *environ_bind(obj_t **frame, obj_t *self, obj_t *key, obj_t *value);
+// Bumped on each new binding by name, which may shadow an outer one, and
+// when a binding is set to syntax. The bindings found by name are cached
+// while it's unchanged. @see OP_GREF
+extern long environ_version;
 
 // *Hashtables*, which indeed increased the lookup speed by 20%.
 enum dict_lookup_flag {
@@ -264,12 +343,75 @@ bool_t macrop(obj_t *self);
 obj_t *macro_expand(obj_t **frame, obj_t *self, obj_t *args);
 
 // Continuations (escaping...)
-obj_t *econt_wrap(obj_t **frame, void *env);
+obj_t *econt_wrap(obj_t **frame, long activation);
 bool_t continuationp(obj_t *self);
 bool_t econtp(obj_t *self);
-jmp_buf *econt_getenv(obj_t *self);
-void econt_clear(obj_t *self);
-obj_t *econt_getaux(obj_t *self);
-void econt_putaux(obj_t *self, obj_t *thing);
+long econt_activation(obj_t *self);
+obj_t **econt_frame(obj_t *self);
+void econt_set_frame(obj_t *self, obj_t **econt_frame);
+
+// Full continuations, the stack words in [from, to) are copied.
+obj_t *cont_wrap(obj_t **frame, obj_t **from, obj_t **to, long activation,
+                 obj_t **cont_frame, long pc);
+bool_t contp(obj_t *self);
+long cont_activation(obj_t *self);
+obj_t **cont_frame(obj_t *self);
+long cont_pc(obj_t *self);
+obj_t **cont_restore(obj_t *self);
+
+// Analysed expression nodes. Kids are listed in the comments.
+enum node_kind {
+    ND_CONST,       // value
+    ND_LREF,        // symbol -- bound in the slot of the frame at depth
+    ND_GREF,        // symbol -- not lexically bound, look outer from depth
+    ND_LSET,        // symbol, value
+    ND_GSET,        // symbol, value
+    ND_DEFINE,      // symbol, value
+    ND_IF,          // pred, todo, otherwise
+    ND_OR,          // expr ... -- the first true value, or the last one
+    ND_CASE,        // key, datums, body, ... -- datums is #t for else
+    ND_SEQ,         // expr ...
+    ND_CALL,        // proc, arg ...
+    ND_LAMBDA,      // formals, body, parent, names, pending
+    ND_MACRO,       // lambda
+    ND_CONS,        // car, cdr
+    ND_APPEND       // list, tail -- a copy of the list, ending with tail
+};
+
+// Kids are initialized to NULL.
+obj_t *node_wrap(obj_t **frame, enum node_kind kind, size_t nb_kids);
+bool_t nodep(obj_t *self);
+enum node_kind node_kind(obj_t *self);
+void node_set_kind(obj_t *self, enum node_kind kind);
+size_t node_length(obj_t *self);
+obj_t *node_ref(obj_t *self, long index);
+void node_set(obj_t *self, long index, obj_t *kid);
+long node_ival(obj_t *self);
+void node_set_ival(obj_t *self, long ival);
+long node_slot(obj_t *self);
+void node_set_slot(obj_t *self, long slot);
+
+// Code objects, the insns are owned by (and freed with) the object.
+obj_t *code_wrap(obj_t **frame, obj_t *lambda);
+bool_t codep(obj_t *self);
+bool_t code_compiledp(obj_t *self);
+long *code_insns(obj_t *self);
+size_t code_length(obj_t *self);
+obj_t *code_consts(obj_t *self);
+obj_t *code_lambda(obj_t *self);
+void code_set_insns(obj_t *self, long *insns, size_t nb_insns,
+                    obj_t *consts);
+size_t code_nb_slots(obj_t *self);
+void code_set_nb_slots(obj_t *self, size_t nb_slots);
+bool_t code_stack_envp(obj_t *self);
+void code_set_stack_env(obj_t *self, bool_t stack_env);
+bool_t code_defs_envp(obj_t *self);
+void code_set_defs_env(obj_t *self, bool_t defs_env);
+long code_epoch(obj_t *self);
+void code_set_epoch(obj_t *self, long epoch);
+// Taken from the formals of the lambda when it's compiled.
+void code_set_arity(obj_t *self, long nb_args, bool_t vararg);
+long code_nb_args(obj_t *self);
+bool_t code_varargp(obj_t *self);
 
 #endif /* SOBJ_H */